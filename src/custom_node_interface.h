@@ -49,6 +49,32 @@ struct CustomNodeParam {
     const char *key, *value;
 };
 
+/**
+ * @brief Version of optional interface extensions declared below the base functions.
+ * Libraries report version they were built with in getCapabilities, callers use only features known to both sides.
+ */
+#define CUSTOM_NODE_EXTENSION_VERSION 2
+
+typedef enum {
+    // executeInto writes outputs into memory provided by caller (since version 1)
+    CUSTOM_NODE_CAPABILITY_EXECUTE_INTO = 1 << 0,
+    // executeAsync runs node in background and reports completion with callback (since version 2)
+    CUSTOM_NODE_CAPABILITY_EXECUTE_ASYNC = 1 << 1
+} CustomNodeCapability;
+
+struct CustomNodeCapabilities {
+    uint32_t version;
+    uint64_t flags;  // bitwise or of CustomNodeCapability values
+};
+
+/**
+ * @brief Called exactly once for each request accepted by executeAsync, on library thread.
+ * status and outputs are the same as returned by execute, outputs are owned by caller and released with release().
+ * Callback should not call deinitialize of the manager it was scheduled with. If it does, requests still queued are completed
+ * before deinitialize returns and library must not be unloaded until callback returns.
+ */
+typedef void (*CustomNodeCompletionCallback)(int status, struct CustomNodeTensor* outputs, int outputsCount, void* userContext);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -58,6 +84,11 @@ extern "C" {
  * Potential use cases include optimized temporary buffers allocation.
  * Using initialize is optional and not required for custom node to work.
  * CustomNodeLibraryInternalManager should be created here if initialize is used.
+ * *customNodeLibraryInternalManager must be set to nullptr by caller for first initialization, new manager is stored there.
+ * Non null *customNodeLibraryInternalManager must hold manager returned by previous initialize of the same library
+ * and not yet passed to deinitialize. That manager is reinitialized with new params: executions in flight complete with
+ * previous configuration and only buffers whose size changed are reallocated. Manager stays valid after reinitialization
+ * failure and still has to be passed to deinitialize. Callers always passing nullptr create new manager each time.
  * On initialize failure status not equal to zero is returned and error log is printed.
  */
 int initialize(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount);
@@ -73,6 +104,28 @@ int getInputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const stru
 int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager);
 int release(void* ptr, void* customNodeLibraryInternalManager);
 
+/**
+ * @brief Optional extension entry points, looked up separately by the caller.
+ * Libraries not exporting getCapabilities support only the functions above, extension functions are used only if reported in flags.
+ */
+int getCapabilities(struct CustomNodeCapabilities* capabilities, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager);
+/**
+ * @brief Custom node execution writing selected outputs into memory provided by caller, e.g. input tensor of next model.
+ * For each preallocated output caller sets name, data with dataBytes capacity and dims with dimsCount capacity.
+ * Library writes output data, actual dataBytes, dims, dimsCount and precision into it. Execution fails with status not equal to zero
+ * if provided memory is too small or library cannot write requested output into caller memory.
+ * Outputs not preallocated by caller are returned in outputs like in execute and must be released with release().
+ */
+int executeInto(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor* preallocatedOutputs, int preallocatedOutputsCount,
+    struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager);
+/**
+ * @brief Schedules custom node execution and returns without waiting for it, completion is reported with callback and userContext.
+ * Inputs and params must stay valid until callback is called. Status not equal to zero means request was not accepted
+ * (e.g. too many requests in flight) and callback will not be called for it.
+ */
+int executeAsync(const struct CustomNodeTensor* inputs, int inputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager,
+    CustomNodeCompletionCallback callback, void* userContext);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,112 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#include "async_executor.hpp"
+
+#include <algorithm>
+#include <optional>
+
+#include "logger.hpp"
+
+namespace ovms {
+namespace custom_nodes_common {
+
+namespace {
+// set on worker thread whose completion callback destroyed its executor
+thread_local bool executorDestroyedFromCallback = false;
+}  // namespace
+
+AsyncExecutor::AsyncExecutor(const AsyncExecutorOptions& options) :
+    options(options),
+    admission(std::max(options.queueSize, 1)) {}
+
+AsyncExecutor::~AsyncExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(requestsMutex);
+        stopping = true;
+    }
+    requestsAvailable.notify_all();
+    for (auto& worker : workers) {
+        if (worker.get_id() != std::this_thread::get_id()) {
+            worker.join();
+            continue;
+        }
+        // destroyed from completion callback, worker cannot join itself and leaves its loop once callback returns
+        NODE_LOG_ERROR("asynchronous executor destroyed from completion callback, deinitialize should not be called from callback");
+        executorDestroyedFromCallback = true;
+        worker.detach();
+    }
+    // requests left when current worker was detached
+    while (!requests.empty()) {
+        Request request = requests.front();
+        requests.pop_front();
+        complete(request);
+    }
+}
+
+bool AsyncExecutor::submit(ExecuteFunction execute, const struct CustomNodeTensor* inputs, int inputsCount, const struct CustomNodeParam* params, int paramsCount,
+    void* customNodeLibraryInternalManager, CustomNodeCompletionCallback callback, void* userContext) {
+    std::optional<int> slot = options.admissionTimeout.count() > 0 ? admission.tryToGetIdleStreamFor(options.admissionTimeout) : admission.tryToGetIdleStream();
+    if (!slot.has_value()) {
+        NODE_LOG_WARNING("asynchronous request rejected, " << options.queueSize << " requests already in flight");
+        return false;
+    }
+    std::call_once(workersStarted, [this]() {
+        for (int i = 0; i < std::max(options.workers, 1); i++) {
+            workers.emplace_back(&AsyncExecutor::run, this);
+        }
+    });
+    {
+        std::lock_guard<std::mutex> lock(requestsMutex);
+        requests.push_back({execute, inputs, inputsCount, params, paramsCount, customNodeLibraryInternalManager, callback, userContext, slot.value()});
+    }
+    requestsAvailable.notify_one();
+    return true;
+}
+
+void AsyncExecutor::run() {
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(requestsMutex);
+            requestsAvailable.wait(lock, [this]() { return stopping || !requests.empty(); });
+            // queued requests are completed before stopping
+            if (requests.empty()) {
+                return;
+            }
+            request = requests.front();
+            requests.pop_front();
+        }
+        complete(request);
+        // executor does not exist anymore
+        if (executorDestroyedFromCallback) {
+            return;
+        }
+    }
+}
+
+void AsyncExecutor::complete(const Request& request) {
+    struct CustomNodeTensor* outputs = nullptr;
+    int outputsCount = 0;
+    int status = request.execute(request.inputs, request.inputsCount, &outputs, &outputsCount, request.params, request.paramsCount, request.customNodeLibraryInternalManager);
+    if (status != 0) {
+        outputs = nullptr;
+        outputsCount = 0;
+    }
+    admission.returnStream(request.slot);
+    request.callback(status, outputs, outputsCount, request.userContext);
+}
+}  // namespace custom_nodes_common
+}  // namespace ovms
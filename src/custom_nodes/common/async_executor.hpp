@@ -0,0 +1,84 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../custom_node_interface.h"
+#include "../../queue.hpp"
+
+namespace ovms {
+namespace custom_nodes_common {
+
+// signature of custom node execute()
+using ExecuteFunction = int (*)(const struct CustomNodeTensor*, int, struct CustomNodeTensor**, int*, const struct CustomNodeParam*, int, void*);
+
+struct AsyncExecutorOptions {
+    // threads running requests, started on first request
+    int workers = 2;
+    // requests accepted at once, queued or running
+    int queueSize = 16;
+    // how long submit waits for a free slot when queueSize requests are in flight
+    std::chrono::milliseconds admissionTimeout{0};
+};
+
+/**
+ * @brief Runs custom node executions on its own worker threads and reports results with completion callback.
+ * Admission is limited by slots handed out by LockFreeQueue, a slot is returned before callback is called
+ * so callback may submit next request. Requests accepted before destruction are completed by destructor.
+ * Destruction from completion callback does not join calling worker, it exits after callback returns.
+ */
+class AsyncExecutor {
+public:
+    explicit AsyncExecutor(const AsyncExecutorOptions& options);
+    ~AsyncExecutor();
+
+    // Returns false if no slot became free within admission timeout, callback is not called then.
+    bool submit(ExecuteFunction execute, const struct CustomNodeTensor* inputs, int inputsCount, const struct CustomNodeParam* params, int paramsCount,
+        void* customNodeLibraryInternalManager, CustomNodeCompletionCallback callback, void* userContext);
+
+private:
+    struct Request {
+        ExecuteFunction execute;
+        const struct CustomNodeTensor* inputs;
+        int inputsCount;
+        const struct CustomNodeParam* params;
+        int paramsCount;
+        void* customNodeLibraryInternalManager;
+        CustomNodeCompletionCallback callback;
+        void* userContext;
+        int slot;
+    };
+
+    void run();
+    void complete(const Request& request);
+
+    const AsyncExecutorOptions options;
+    LockFreeQueue<int> admission;
+    std::mutex requestsMutex;
+    std::condition_variable requestsAvailable;
+    std::deque<Request> requests;
+    bool stopping = false;
+    std::once_flag workersStarted;
+    std::vector<std::thread> workers;
+};
+}  // namespace custom_nodes_common
+}  // namespace ovms
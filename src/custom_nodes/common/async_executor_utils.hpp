@@ -0,0 +1,58 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include "../../custom_node_interface.h"
+#include "async_executor.hpp"
+#include "custom_node_library_internal_manager.hpp"
+#include "utils.hpp"
+
+// Reads parameters of asynchronous execution shared by all nodes implementing executeAsync:
+// async_workers - threads running asynchronous requests of node, 2 by default
+// async_queue_size - maximal number of asynchronous requests in flight, 16 by default
+// async_admission_timeout_ms - how long executeAsync waits for a free slot when queue is full, 0 (reject at once) by default
+ovms::custom_nodes_common::AsyncExecutorOptions get_async_executor_options(const struct CustomNodeParam* params, int paramsCount) {
+    ovms::custom_nodes_common::AsyncExecutorOptions options;
+    options.workers = get_int_parameter("async_workers", params, paramsCount, options.workers);
+    NODE_EXPECT(options.workers > 0, "async workers must be larger than 0, using 1");
+    options.queueSize = get_int_parameter("async_queue_size", params, paramsCount, options.queueSize);
+    NODE_EXPECT(options.queueSize > 0, "async queue size must be larger than 0, using 1");
+    int admissionTimeoutMs = get_int_parameter("async_admission_timeout_ms", params, paramsCount, 0);
+    NODE_EXPECT(admissionTimeoutMs >= 0, "async admission timeout must not be negative, using 0");
+    options.admissionTimeout = std::chrono::milliseconds(std::max(admissionTimeoutMs, 0));
+    return options;
+}
+
+// Executor is created with the first initialize() and kept on reinitialization, since it cannot be replaced while requests are running.
+void create_async_executor(ovms::custom_nodes_common::CustomNodeLibraryInternalManager* internalManager, const struct CustomNodeParam* params, int paramsCount) {
+    internalManager->setAsyncExecutor(std::make_unique<ovms::custom_nodes_common::AsyncExecutor>(get_async_executor_options(params, paramsCount)));
+}
+
+// Schedules node execute() on executor of its internal manager.
+int execute_async(ovms::custom_nodes_common::ExecuteFunction execute, const struct CustomNodeTensor* inputs, int inputsCount, const struct CustomNodeParam* params, int paramsCount,
+    void* customNodeLibraryInternalManager, CustomNodeCompletionCallback callback, void* userContext) {
+    auto* internalManager = static_cast<ovms::custom_nodes_common::CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+    NODE_ASSERT(internalManager != nullptr, "internalManager is not initialized");
+    ovms::custom_nodes_common::LogSettings::Scope logScope(internalManager->getLogSettings());
+    NODE_ASSERT(internalManager->getAsyncExecutor() != nullptr, "asynchronous execution is not initialized");
+    NODE_ASSERT(callback != nullptr, "completion callback is required");
+    NODE_ASSERT(internalManager->getAsyncExecutor()->submit(execute, inputs, inputsCount, params, paramsCount, internalManager, callback, userContext), "asynchronous request was not accepted");
+    return 0;
+}
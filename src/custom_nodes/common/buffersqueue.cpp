@@ -16,43 +16,171 @@
 
 #include "buffersqueue.hpp"
 
-#include <iostream>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "logger.hpp"
 
 namespace ovms {
 namespace custom_nodes_common {
-BuffersQueue::BuffersQueue(size_t singleBufferSize, int streamsLength) :
-    Queue(streamsLength),
+static constexpr size_t REGULAR_PAGE_SIZE = 4096;
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+// from linux/mempolicy.h, not using libnuma to avoid additional dependency
+static constexpr int MPOL_BIND_MODE = 2;
+static constexpr unsigned MPOL_MF_MOVE_FLAG = 1 << 1;
+
+static size_t roundUp(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+static size_t slotSizeFor(size_t singleBufferSize, BuffersQueueOptions& options) {
+    if (options.alignment == 0 || (options.alignment & (options.alignment - 1)) != 0 || options.alignment > REGULAR_PAGE_SIZE) {
+        NODE_LOG_WARNING("Buffers queue alignment " << options.alignment << " must be power of 2 not larger than " << REGULAR_PAGE_SIZE << ", using 64");
+        options.alignment = 64;
+    }
+    return roundUp(std::max(singleBufferSize, static_cast<size_t>(1)) + options.padding, options.alignment);
+}
+
+static int streamsCapacity(int streamsLength, const BuffersQueueOptions& options) {
+    if (options.exhaustionPolicy != BuffersQueueExhaustionPolicy::GROW) {
+        return streamsLength;
+    }
+    return std::max(streamsLength, options.maxStreamsLength);
+}
+
+BuffersQueue::BuffersQueue(size_t singleBufferSize, int streamsLength, const BuffersQueueOptions& options) :
+    LockFreeQueue(streamsLength, streamsCapacity(streamsLength, options)),
     singleBufferSize(singleBufferSize),
-    size(singleBufferSize * streamsLength),
-    memoryPool(std::make_unique<char[]>(size)) {
-    for (int i = 0; i < streamsLength; ++i) {
-        inferRequests.push_back(memoryPool.get() + i * singleBufferSize);
+    options(options),
+    initialStreamsLength(streamsLength),
+    streamsLength(streamsLength) {
+    slotSize = slotSizeFor(singleBufferSize, this->options);
+    capacity = streamsCapacity(streamsLength, this->options);
+    // pool size not representable in size_t cannot be mapped
+    if (slotSize < singleBufferSize || (capacity > 0 && slotSize > SIZE_MAX / capacity)) {
+        throw std::bad_alloc();
     }
+    size = slotSize * capacity;
+    allocateMemoryPool(streamsLength);
+    for (int i = 0; i < capacity; ++i) {
+        inferRequests.push_back(memoryPool + i * slotSize);
+    }
+}
+
+BuffersQueue::~BuffersQueue() {
+    munmap(mappedMemory, mappedSize);
 }
 
-BuffersQueue::~BuffersQueue() {}
+void BuffersQueue::allocateMemoryPool(int streamsLength) {
+    if (options.hugePages == BuffersQueueHugePages::HUGETLB) {
+        mappedSize = roundUp(size, HUGE_PAGE_SIZE);
+        mappedMemory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mappedMemory == MAP_FAILED) {
+            NODE_LOG_WARNING("Buffers queue could not map " << mappedSize << " bytes of huge pages, using transparent huge pages");
+            mappedMemory = nullptr;
+        } else {
+            memoryPool = static_cast<char*>(mappedMemory);
+        }
+    }
+    if (mappedMemory == nullptr) {
+        // mapping one huge page more allows to start pool at huge page boundary
+        bool transparentHugePages = options.hugePages != BuffersQueueHugePages::NONE;
+        mappedSize = transparentHugePages ? size + HUGE_PAGE_SIZE : size;
+        mappedMemory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mappedMemory == MAP_FAILED) {
+            mappedMemory = nullptr;
+            throw std::bad_alloc();
+        }
+        memoryPool = static_cast<char*>(mappedMemory);
+        if (transparentHugePages) {
+            memoryPool = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(mappedMemory), HUGE_PAGE_SIZE));
+            if (madvise(memoryPool, size, MADV_HUGEPAGE) != 0) {
+                NODE_LOG_WARNING("Buffers queue transparent huge pages are not available");
+            }
+        }
+    }
+    if (options.numaNode >= 0) {
+        // policy has to be set before pages are touched
+        const size_t bitsPerWord = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> nodeMask(options.numaNode / bitsPerWord + 1, 0);
+        nodeMask[options.numaNode / bitsPerWord] |= 1UL << (options.numaNode % bitsPerWord);
+        if (syscall(SYS_mbind, memoryPool, size, MPOL_BIND_MODE, nodeMask.data(), nodeMask.size() * bitsPerWord + 1, MPOL_MF_MOVE_FLAG) != 0) {
+            NODE_LOG_WARNING("Buffers queue could not be bound to NUMA node " << options.numaNode);
+        }
+    }
+    if (options.prefault) {
+        // memory reserved for growth is not touched until buffers are added
+        size_t prefaultSize = slotSize * streamsLength;
+        for (size_t offset = 0; offset < prefaultSize; offset += REGULAR_PAGE_SIZE) {
+            memoryPool[offset] = 0;
+        }
+    }
+}
 
 void* BuffersQueue::getBuffer() {
-    // can be easily switched to async version if need arise
     auto idleId = tryToGetIdleStream();
-    if (idleId.has_value()) {
-        return getInferRequest(idleId.value());
+    if (!idleId.has_value()) {
+        switch (options.exhaustionPolicy) {
+        case BuffersQueueExhaustionPolicy::WAIT: {
+            auto start = std::chrono::steady_clock::now();
+            idleId = tryToGetIdleStreamFor(options.waitTimeout);
+            waits.fetch_add(1, std::memory_order_relaxed);
+            waitTimeUs.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+            break;
+        }
+        case BuffersQueueExhaustionPolicy::GROW:
+            idleId = tryToGrow();
+            break;
+        case BuffersQueueExhaustionPolicy::HEAP_FALLBACK:
+            break;
+        }
+    }
+    if (!idleId.has_value()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
     }
-    return nullptr;
+    hits.fetch_add(1, std::memory_order_relaxed);
+    uint64_t currentlyInUse = inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t previousHighWaterMark = highWaterMark.load(std::memory_order_relaxed);
+    while (previousHighWaterMark < currentlyInUse &&
+           !highWaterMark.compare_exchange_weak(previousHighWaterMark, currentlyInUse, std::memory_order_relaxed)) {
+    }
+    return getInferRequest(idleId.value());
+}
+
+std::optional<int> BuffersQueue::tryToGrow() {
+    int currentStreamsLength = streamsLength.load(std::memory_order_relaxed);
+    while (currentStreamsLength < capacity) {
+        if (streamsLength.compare_exchange_weak(currentStreamsLength, currentStreamsLength + 1, std::memory_order_relaxed)) {
+            grows.fetch_add(1, std::memory_order_relaxed);
+            // new buffer is handed out directly, it joins the idle ring once returned
+            return currentStreamsLength;
+        }
+    }
+    return std::nullopt;
 }
 
 bool BuffersQueue::returnBuffer(void* buffer) {
-    if ((static_cast<char*>(buffer) < memoryPool.get()) ||
-        ((memoryPool.get() + size - 1) < buffer) ||
-        ((static_cast<char*>(buffer) - memoryPool.get()) % singleBufferSize != 0)) {
+    if ((static_cast<char*>(buffer) < memoryPool) ||
+        ((memoryPool + size - 1) < buffer) ||
+        ((static_cast<char*>(buffer) - memoryPool) % slotSize != 0)) {
         return false;
     }
     returnStream(getBufferId(buffer));
+    // retired pool may be freed once this reaches zero, so it has to be the last access
+    inUse.fetch_sub(1, std::memory_order_release);
     return true;
 }
 
 int BuffersQueue::getBufferId(void* buffer) {
-    return (static_cast<char*>(buffer) - memoryPool.get()) / singleBufferSize;
+    return (static_cast<char*>(buffer) - memoryPool) / slotSize;
 }
 
 const size_t BuffersQueue::getSize() {
@@ -62,5 +190,32 @@ const size_t BuffersQueue::getSize() {
 const size_t BuffersQueue::getSingleBufferSize() {
     return this->singleBufferSize;
 }
+
+const char* BuffersQueue::getMemoryPool() {
+    return this->memoryPool;
+}
+
+int BuffersQueue::getStreamsLength() {
+    return this->initialStreamsLength;
+}
+
+const BuffersQueueOptions& BuffersQueue::getOptions() {
+    return this->options;
+}
+
+int64_t BuffersQueue::getBuffersInUse() {
+    return this->inUse.load(std::memory_order_acquire);
+}
+
+BuffersQueueStatistics BuffersQueue::getStatistics() {
+    BuffersQueueStatistics statistics;
+    statistics.hits = hits.load(std::memory_order_relaxed);
+    statistics.misses = misses.load(std::memory_order_relaxed);
+    statistics.waits = waits.load(std::memory_order_relaxed);
+    statistics.waitTimeUs = waitTimeUs.load(std::memory_order_relaxed);
+    statistics.grows = grows.load(std::memory_order_relaxed);
+    statistics.highWaterMark = highWaterMark.load(std::memory_order_relaxed);
+    return statistics;
+}
 }  // namespace custom_nodes_common
 }  // namespace ovms
@@ -16,7 +16,9 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <future>
 #include <memory>
 #include <mutex>
@@ -29,21 +31,97 @@
 namespace ovms {
 namespace custom_nodes_common {
 
-class BuffersQueue : protected Queue<char*> {
+/**
+ * @brief Behaviour of getBuffer() when all buffers are in use
+ */
+enum class BuffersQueueExhaustionPolicy {
+    HEAP_FALLBACK,  // return nullptr immediately, caller allocates on heap
+    WAIT,           // wait up to waitTimeout for a buffer to be returned, then fall back to heap
+    GROW            // add buffers up to maxStreamsLength, then fall back to heap
+};
+
+/**
+ * @brief Backing pages of the memory pool
+ */
+enum class BuffersQueueHugePages {
+    NONE,         // regular pages
+    TRANSPARENT,  // pool aligned to huge page boundary and advised for transparent huge pages
+    HUGETLB       // explicit huge pages from the reserved pool, transparent huge pages if none are available
+};
+
+struct BuffersQueueOptions {
+    BuffersQueueExhaustionPolicy exhaustionPolicy = BuffersQueueExhaustionPolicy::HEAP_FALLBACK;
+    std::chrono::microseconds waitTimeout = std::chrono::milliseconds(10);
+    int maxStreamsLength = 0;
+
+    size_t alignment = 64;  // alignment of each buffer start, power of 2 not larger than page size
+    size_t padding = 0;     // additional bytes between buffers, i.e. to avoid cache set aliasing of page sized buffers
+    BuffersQueueHugePages hugePages = BuffersQueueHugePages::NONE;
+    bool prefault = true;  // touch initial buffers pages on creation instead of on first use
+    int numaNode = -1;     // bind pool memory to NUMA node, -1 leaves placement to first touch
+};
+
+inline bool operator==(const BuffersQueueOptions& lhs, const BuffersQueueOptions& rhs) {
+    return lhs.exhaustionPolicy == rhs.exhaustionPolicy &&
+           lhs.waitTimeout == rhs.waitTimeout &&
+           lhs.maxStreamsLength == rhs.maxStreamsLength &&
+           lhs.alignment == rhs.alignment &&
+           lhs.padding == rhs.padding &&
+           lhs.hugePages == rhs.hugePages &&
+           lhs.prefault == rhs.prefault &&
+           lhs.numaNode == rhs.numaNode;
+}
+
+inline bool operator!=(const BuffersQueueOptions& lhs, const BuffersQueueOptions& rhs) {
+    return !(lhs == rhs);
+}
+
+struct BuffersQueueStatistics {
+    uint64_t hits;           // buffers served from pool
+    uint64_t misses;         // requests left for heap fallback
+    uint64_t waits;          // requests which had to wait for returned buffer
+    uint64_t waitTimeUs;     // total time spent waiting
+    uint64_t grows;          // buffers added to pool with GROW policy
+    uint64_t highWaterMark;  // maximum number of buffers in use at once
+};
+
+class BuffersQueue : protected LockFreeQueue<char*> {
     size_t singleBufferSize;
+    size_t slotSize;
+    BuffersQueueOptions options;
+    int initialStreamsLength;
+    int capacity;
     size_t size;
-    std::unique_ptr<char[]> memoryPool;
+    char* memoryPool = nullptr;
+    void* mappedMemory = nullptr;
+    size_t mappedSize = 0;
+
+    std::atomic<int> streamsLength;
+    std::atomic<int64_t> inUse{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> waits{0};
+    std::atomic<uint64_t> waitTimeUs{0};
+    std::atomic<uint64_t> grows{0};
+    std::atomic<uint64_t> highWaterMark{0};
 
 public:
-    BuffersQueue(size_t singleBufferSize, int streamsLength);
+    BuffersQueue(size_t singleBufferSize, int streamsLength, const BuffersQueueOptions& options = BuffersQueueOptions());
     ~BuffersQueue();
     void* getBuffer();
     bool returnBuffer(void* buffer);
     const size_t getSize();
     const size_t getSingleBufferSize();
+    const char* getMemoryPool();
+    int getStreamsLength();
+    const BuffersQueueOptions& getOptions();
+    int64_t getBuffersInUse();
+    BuffersQueueStatistics getStatistics();
 
 private:
+    void allocateMemoryPool(int streamsLength);
     int getBufferId(void* buffer);
+    std::optional<int> tryToGrow();
 };
 }  // namespace custom_nodes_common
 }  // namespace ovms
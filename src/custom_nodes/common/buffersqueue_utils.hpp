@@ -0,0 +1,78 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include "../../custom_node_interface.h"
+#include "buffersqueue.hpp"
+#include "utils.hpp"
+
+// Reads pool exhaustion parameters shared by all nodes using BuffersQueue:
+// buffer_queue_exhaustion_policy - heap (default), wait or grow
+// buffer_queue_wait_timeout_ms - maximum wait for returned buffer with wait policy
+// buffer_queue_max_size - upper limit of buffers with grow policy, twice the buffer_queue_size by default
+// and pool memory parameters:
+// buffer_queue_alignment - alignment of each buffer start in bytes, 64 by default
+// buffer_queue_padding - additional bytes between buffers
+// buffer_queue_huge_pages - none (default), transparent or hugetlb
+// buffer_queue_prefault - touch initial buffers on creation, true by default
+// buffer_queue_numa_node - NUMA node to bind pool memory to
+ovms::custom_nodes_common::BuffersQueueOptions get_buffers_queue_options(const struct CustomNodeParam* params, int paramsCount, int streamsLength) {
+    using ovms::custom_nodes_common::BuffersQueueExhaustionPolicy;
+    using ovms::custom_nodes_common::BuffersQueueHugePages;
+    ovms::custom_nodes_common::BuffersQueueOptions options;
+
+    std::string exhaustionPolicy = get_string_parameter("buffer_queue_exhaustion_policy", params, paramsCount, "heap");
+    if (exhaustionPolicy == "wait") {
+        options.exhaustionPolicy = BuffersQueueExhaustionPolicy::WAIT;
+    } else if (exhaustionPolicy == "grow") {
+        options.exhaustionPolicy = BuffersQueueExhaustionPolicy::GROW;
+    } else {
+        NODE_EXPECT(exhaustionPolicy == "heap", "buffer queue exhaustion policy must be heap, wait or grow, using heap");
+        options.exhaustionPolicy = BuffersQueueExhaustionPolicy::HEAP_FALLBACK;
+    }
+
+    int waitTimeoutMs = get_int_parameter("buffer_queue_wait_timeout_ms", params, paramsCount, 10);
+    NODE_EXPECT(waitTimeoutMs >= 0, "buffer queue wait timeout must not be negative, using 0");
+    options.waitTimeout = std::chrono::milliseconds(std::max(waitTimeoutMs, 0));
+
+    options.maxStreamsLength = get_int_parameter("buffer_queue_max_size", params, paramsCount, 2 * streamsLength);
+    NODE_EXPECT(options.maxStreamsLength >= streamsLength, "buffer queue max size is smaller than buffer queue size, pool will not grow");
+
+    int alignment = get_int_parameter("buffer_queue_alignment", params, paramsCount, 64);
+    NODE_EXPECT(alignment > 0, "buffer queue alignment must be larger than 0, using 64");
+    options.alignment = alignment > 0 ? alignment : 64;
+    int padding = get_int_parameter("buffer_queue_padding", params, paramsCount, 0);
+    NODE_EXPECT(padding >= 0, "buffer queue padding must not be negative, using 0");
+    options.padding = std::max(padding, 0);
+
+    std::string hugePages = get_string_parameter("buffer_queue_huge_pages", params, paramsCount, "none");
+    if (hugePages == "transparent") {
+        options.hugePages = BuffersQueueHugePages::TRANSPARENT;
+    } else if (hugePages == "hugetlb") {
+        options.hugePages = BuffersQueueHugePages::HUGETLB;
+    } else {
+        NODE_EXPECT(hugePages == "none", "buffer queue huge pages must be none, transparent or hugetlb, using none");
+        options.hugePages = BuffersQueueHugePages::NONE;
+    }
+
+    options.prefault = get_string_parameter("buffer_queue_prefault", params, paramsCount, "true") == "true";
+    options.numaNode = get_int_parameter("buffer_queue_numa_node", params, paramsCount, -1);
+    return options;
+}
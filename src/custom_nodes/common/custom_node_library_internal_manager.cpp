@@ -16,38 +16,69 @@
 
 #include "custom_node_library_internal_manager.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <shared_mutex>
 #include <string>
 
+#include "logger.hpp"
+
 namespace ovms {
 namespace custom_nodes_common {
 CustomNodeLibraryInternalManager::CustomNodeLibraryInternalManager() {
 }
 
+// Memory pool allocation failure is reported as nullptr, so it fails node initialization instead of escaping C interface.
+static std::unique_ptr<BuffersQueue> makeBuffersQueue(size_t singleBufferSize, int streamsLength, const BuffersQueueOptions& options) {
+    try {
+        return std::make_unique<BuffersQueue>(singleBufferSize, streamsLength, options);
+    } catch (const std::bad_alloc&) {
+        NODE_LOG_ERROR("Buffers queue memory pool of " << streamsLength << " x " << singleBufferSize << " bytes could not be allocated");
+        return nullptr;
+    }
+}
+
 CustomNodeLibraryInternalManager::~CustomNodeLibraryInternalManager() {
+    // pending asynchronous requests are completed while the rest of manager is still valid
+    asyncExecutor.reset();
 }
 
-bool CustomNodeLibraryInternalManager::createBuffersQueue(const std::string& name, size_t singleBufferSize, int streamsLength) {
+bool CustomNodeLibraryInternalManager::createBuffersQueue(const std::string& name, size_t singleBufferSize, int streamsLength, const BuffersQueueOptions& options) {
     auto it = outputBuffers.find(name);
     if (it != outputBuffers.end()) {
         return false;
     }
-    outputBuffers.emplace(name, std::make_unique<BuffersQueue>(singleBufferSize, streamsLength));
+    std::unique_ptr<BuffersQueue> buffersQueue = makeBuffersQueue(singleBufferSize, streamsLength, options);
+    if (buffersQueue == nullptr) {
+        return false;
+    }
+    std::unique_lock<std::shared_timed_mutex> lock(buffersQueueRangesLock);
+    outputBuffers.emplace(name, std::move(buffersQueue));
+    rebuildBuffersQueueRanges();
     return true;
 }
 
-bool CustomNodeLibraryInternalManager::recreateBuffersQueue(const std::string& name, size_t singleBufferSize, int streamsLength) {
+bool CustomNodeLibraryInternalManager::recreateBuffersQueue(const std::string& name, size_t singleBufferSize, int streamsLength, const BuffersQueueOptions& options) {
     auto it = outputBuffers.find(name);
-    if (it != outputBuffers.end()) {
-        if (!(it->second->getSize() == singleBufferSize &&
-                it->second->getSingleBufferSize() == streamsLength * singleBufferSize)) {
-            it->second.reset(new BuffersQueue(singleBufferSize, streamsLength));
-        }
+    if (it == outputBuffers.end()) {
+        return createBuffersQueue(name, singleBufferSize, streamsLength, options);
+    }
+    if (it->second->getSingleBufferSize() == singleBufferSize &&
+        it->second->getStreamsLength() == streamsLength &&
+        it->second->getOptions() == options) {
         return true;
     }
-    return false;
+    std::unique_ptr<BuffersQueue> buffersQueue = makeBuffersQueue(singleBufferSize, streamsLength, options);
+    if (buffersQueue == nullptr) {
+        return false;
+    }
+    std::unique_lock<std::shared_timed_mutex> lock(buffersQueueRangesLock);
+    retiredBuffers.push_back(std::move(it->second));
+    it->second = std::move(buffersQueue);
+    freeDrainedBuffersQueues();
+    return true;
 }
 
 BuffersQueue* CustomNodeLibraryInternalManager::getBuffersQueue(const std::string& name) {
@@ -58,14 +89,97 @@ BuffersQueue* CustomNodeLibraryInternalManager::getBuffersQueue(const std::strin
 }
 
 bool CustomNodeLibraryInternalManager::releaseBuffer(void* ptr) {
-    for (auto it = outputBuffers.begin(); it != outputBuffers.end(); ++it) {
-        if (it->second->returnBuffer(ptr)) {
+    bool drained = false;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(buffersQueueRangesLock);
+        BuffersQueue* buffersQueue = findBuffersQueue(ptr);
+        if (buffersQueue == nullptr) {
+            // buffer was allocated on heap
+            return false;
+        }
+        if (!buffersQueue->returnBuffer(ptr)) {
+            return false;
+        }
+        drained = buffersQueue->getBuffersInUse() == 0 && isRetired(buffersQueue);
+    }
+    if (drained) {
+        std::unique_lock<std::shared_timed_mutex> lock(buffersQueueRangesLock);
+        freeDrainedBuffersQueues();
+    }
+    return true;
+}
+
+bool CustomNodeLibraryInternalManager::isRetired(BuffersQueue* buffersQueue) {
+    for (auto& retired : retiredBuffers) {
+        if (retired.get() == buffersQueue) {
             return true;
         }
     }
     return false;
 }
 
+void CustomNodeLibraryInternalManager::freeDrainedBuffersQueues() {
+    retiredBuffers.erase(std::remove_if(retiredBuffers.begin(), retiredBuffers.end(),
+                             [](const std::unique_ptr<BuffersQueue>& retired) { return retired->getBuffersInUse() == 0; }),
+        retiredBuffers.end());
+    rebuildBuffersQueueRanges();
+}
+
+void CustomNodeLibraryInternalManager::rebuildBuffersQueueRanges() {
+    buffersQueueRanges.clear();
+    for (auto it = outputBuffers.begin(); it != outputBuffers.end(); ++it) {
+        uintptr_t begin = reinterpret_cast<uintptr_t>(it->second->getMemoryPool());
+        buffersQueueRanges.push_back({begin, begin + it->second->getSize(), it->second.get()});
+    }
+    for (auto& retired : retiredBuffers) {
+        uintptr_t begin = reinterpret_cast<uintptr_t>(retired->getMemoryPool());
+        buffersQueueRanges.push_back({begin, begin + retired->getSize(), retired.get()});
+    }
+    std::sort(buffersQueueRanges.begin(), buffersQueueRanges.end(),
+        [](const BuffersQueueRange& lhs, const BuffersQueueRange& rhs) { return lhs.begin < rhs.begin; });
+}
+
+BuffersQueue* CustomNodeLibraryInternalManager::findBuffersQueue(void* ptr) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    // first range starting after address, candidate owner is the one preceding it
+    auto it = std::upper_bound(buffersQueueRanges.begin(), buffersQueueRanges.end(), address,
+        [](uintptr_t address, const BuffersQueueRange& range) { return address < range.begin; });
+    if (it == buffersQueueRanges.begin()) {
+        return nullptr;
+    }
+    --it;
+    if (address >= it->end) {
+        return nullptr;
+    }
+    return it->buffersQueue;
+}
+
+void CustomNodeLibraryInternalManager::printStatistics(std::ostream& stream) {
+    for (auto it = outputBuffers.begin(); it != outputBuffers.end(); ++it) {
+        BuffersQueueStatistics statistics = it->second->getStatistics();
+        stream << "Buffers queue " << it->first
+               << ": hits " << statistics.hits
+               << ", misses " << statistics.misses
+               << ", waits " << statistics.waits
+               << ", wait time " << statistics.waitTimeUs << "us"
+               << ", grows " << statistics.grows
+               << ", high water mark " << statistics.highWaterMark << std::endl;
+    }
+}
+
+void CustomNodeLibraryInternalManager::logStatistics() {
+    for (auto it = outputBuffers.begin(); it != outputBuffers.end(); ++it) {
+        BuffersQueueStatistics statistics = it->second->getStatistics();
+        NODE_LOG_DEBUG("Buffers queue " << it->first
+                                        << ": hits " << statistics.hits
+                                        << ", misses " << statistics.misses
+                                        << ", waits " << statistics.waits
+                                        << ", wait time " << statistics.waitTimeUs << "us"
+                                        << ", grows " << statistics.grows
+                                        << ", high water mark " << statistics.highWaterMark);
+    }
+}
+
 std::shared_timed_mutex& CustomNodeLibraryInternalManager::getInternalManagerLock() {
     return this->internalManagerLock;
 }
@@ -15,40 +15,107 @@
 //*****************************************************************************
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <ostream>
 #include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "../../custom_node_interface.h"
+#include "../common/async_executor.hpp"
 #include "../common/buffersqueue.hpp"
+#include "../common/logger.hpp"
 
 namespace ovms {
 namespace custom_nodes_common {
 
 class CustomNodeLibraryInternalManager {
+    struct BuffersQueueRange {
+        uintptr_t begin;
+        uintptr_t end;
+        BuffersQueue* buffersQueue;
+    };
+
     std::unordered_map<std::string, std::unique_ptr<BuffersQueue>> outputBuffers;
+    // queues replaced by recreateBuffersQueue, kept until all their buffers are returned
+    std::vector<std::unique_ptr<BuffersQueue>> retiredBuffers;
+    // memory pools address ranges sorted by begin address, used to find owning queue of released buffer
+    std::vector<BuffersQueueRange> buffersQueueRanges;
+    // guards ranges and retired queues, since buffers are released without internalManagerLock
+    std::shared_timed_mutex buffersQueueRangesLock;
     std::shared_timed_mutex internalManagerLock;
+    // node specific parameters parsed and validated in initialize()
+    std::shared_ptr<const void> parameters;
+    // runs executeAsync requests of node
+    std::unique_ptr<AsyncExecutor> asyncExecutor;
+    // level and rate limit of node messages, active on threads initializing or executing node
+    LogSettings logSettings;
+
+    void rebuildBuffersQueueRanges();
+    BuffersQueue* findBuffersQueue(void* ptr);
+    bool isRetired(BuffersQueue* buffersQueue);
+    void freeDrainedBuffersQueues();
 
 public:
     CustomNodeLibraryInternalManager();
     ~CustomNodeLibraryInternalManager();
-    bool createBuffersQueue(const std::string& name, size_t singleBufferSize, int streamsLength);
-    bool recreateBuffersQueue(const std::string& name, size_t singleBufferSize, int streamsLength);
+    bool createBuffersQueue(const std::string& name, size_t singleBufferSize, int streamsLength, const BuffersQueueOptions& options = BuffersQueueOptions());
+    /**
+     * @brief Creates queue or replaces it if its geometry or options differ.
+     * Replaced queue is freed once all its buffers in flight are released.
+     * Requires internalManagerLock to be held exclusively, so no buffer is taken from replaced queue.
+     */
+    bool recreateBuffersQueue(const std::string& name, size_t singleBufferSize, int streamsLength, const BuffersQueueOptions& options = BuffersQueueOptions());
     BuffersQueue* getBuffersQueue(const std::string& name);
     bool releaseBuffer(void* ptr);
+    void printStatistics(std::ostream& stream);
+    // writes statistics of every buffers queue to node logger at debug level
+    void logStatistics();
     std::shared_timed_mutex& getInternalManagerLock();
+    /**
+     * @brief Stores parameters parsed by node in initialize(), replacing previous ones.
+     * Requires internalManagerLock to be held exclusively if manager is already in use.
+     */
+    template <typename T>
+    void setParameters(std::unique_ptr<T> newParameters) {
+        parameters = std::shared_ptr<const T>(std::move(newParameters));
+    }
+    /**
+     * @brief Returns parameters stored with setParameters<T>() or nullptr if none were stored.
+     * Valid as long as internalManagerLock is held.
+     */
+    template <typename T>
+    const T* getParameters() const {
+        return static_cast<const T*>(parameters.get());
+    }
+    /**
+     * @brief Sets executor of asynchronous requests, only before manager is used for execution.
+     */
+    void setAsyncExecutor(std::unique_ptr<AsyncExecutor> executor) {
+        asyncExecutor = std::move(executor);
+    }
+    AsyncExecutor* getAsyncExecutor() {
+        return asyncExecutor.get();
+    }
+    LogSettings& getLogSettings() {
+        return logSettings;
+    }
 };
 }  // namespace custom_nodes_common
 }  // namespace ovms
 
 template <typename T>
 bool get_buffer(ovms::custom_nodes_common::CustomNodeLibraryInternalManager* internalManager, T** buffer, const char* buffersQueueName, uint64_t byte_size) {
+    *buffer = nullptr;
     auto buffersQueue = internalManager->getBuffersQueue(buffersQueueName);
-    if (!(buffersQueue == nullptr)) {
+    // buffers larger than pool slot (i.e. dynamic output shapes) are allocated on heap
+    if (buffersQueue != nullptr && byte_size <= buffersQueue->getSingleBufferSize()) {
         *buffer = static_cast<T*>(buffersQueue->getBuffer());
     }
-    if (*buffer == nullptr || buffersQueue == nullptr) {
+    if (*buffer == nullptr) {
         *buffer = (T*)malloc(byte_size);
         if (*buffer == nullptr) {
             return false;
@@ -0,0 +1,129 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+
+#include "detections.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DETECTIONS_X86
+#endif
+
+namespace ovms {
+namespace custom_nodes_common {
+
+#ifdef DETECTIONS_X86
+static const bool cpuHasAvx2 = __builtin_cpu_supports("avx2");
+#endif
+
+static size_t select_rows_above_scalar(const float* rows, size_t begin, size_t rowsCount, size_t rowStride, size_t column, float threshold, uint32_t* selected) {
+    size_t selectedCount = 0;
+    for (size_t i = begin; i < rowsCount; i++) {
+        if (rows[i * rowStride + column] > threshold) {
+            selected[selectedCount++] = (uint32_t)i;
+        }
+    }
+    return selectedCount;
+}
+
+static float find_max_scalar(const float* values, int count, int* index) {
+    float maximum = values[0];
+    int maximumIndex = 0;
+    for (int i = 1; i < count; i++) {
+        if (values[i] > maximum) {
+            maximum = values[i];
+            maximumIndex = i;
+        }
+    }
+    *index = maximumIndex;
+    return maximum;
+}
+
+#ifdef DETECTIONS_X86
+// Column of 8 consecutive rows is gathered and compared at once, selected rows are extracted from comparison mask.
+__attribute__((target("avx2"))) static size_t select_rows_above_avx2(const float* rows, size_t rowsCount, size_t rowStride, size_t column, float threshold, uint32_t* selected) {
+    const __m256i rowOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)rowStride));
+    const __m256 limit = _mm256_set1_ps(threshold);
+    size_t selectedCount = 0;
+    size_t i = 0;
+    for (; i + 8 <= rowsCount; i += 8) {
+        __m256 values = _mm256_i32gather_ps(rows + i * rowStride + column, rowOffsets, 4);
+        unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(values, limit, _CMP_GT_OQ));
+        while (mask != 0) {
+            selected[selectedCount++] = (uint32_t)(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return selectedCount + select_rows_above_scalar(rows, i, rowsCount, rowStride, column, threshold, selected + selectedCount);
+}
+
+__attribute__((target("avx2"))) static float find_max_avx2(const float* values, int count, int* index) {
+    if (count < 16) {
+        return find_max_scalar(values, count, index);
+    }
+    __m256 maximum = _mm256_loadu_ps(values);
+    int i = 8;
+    for (; i + 8 <= count; i += 8) {
+        maximum = _mm256_max_ps(maximum, _mm256_loadu_ps(values + i));
+    }
+    // reduce to single value and include tail
+    __m128 reduced = _mm_max_ps(_mm256_castps256_ps128(maximum), _mm256_extractf128_ps(maximum, 1));
+    reduced = _mm_max_ps(reduced, _mm_movehl_ps(reduced, reduced));
+    reduced = _mm_max_ss(reduced, _mm_shuffle_ps(reduced, reduced, 1));
+    float result = _mm_cvtss_f32(reduced);
+    for (; i < count; i++) {
+        result = values[i] > result ? values[i] : result;
+    }
+    // first occurrence of maximum
+    const __m256 target = _mm256_set1_ps(result);
+    int j = 0;
+    for (; j + 8 <= count; j += 8) {
+        unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + j), target, _CMP_EQ_OQ));
+        if (mask != 0) {
+            *index = j + __builtin_ctz(mask);
+            return result;
+        }
+    }
+    for (; j < count; j++) {
+        if (values[j] == result) {
+            *index = j;
+            return result;
+        }
+    }
+    // only NaN values
+    return find_max_scalar(values, count, index);
+}
+#endif
+
+size_t select_rows_above(const float* rows, size_t rowsCount, size_t rowStride, size_t column, float threshold, uint32_t* selected) {
+#ifdef DETECTIONS_X86
+    // 32 bit gather offsets
+    if (cpuHasAvx2 && rowStride * 8 < (size_t)INT32_MAX) {
+        return select_rows_above_avx2(rows, rowsCount, rowStride, column, threshold, selected);
+    }
+#endif
+    return select_rows_above_scalar(rows, 0, rowsCount, rowStride, column, threshold, selected);
+}
+
+float find_max(const float* values, int count, int* index) {
+#ifdef DETECTIONS_X86
+    if (cpuHasAvx2) {
+        return find_max_avx2(values, count, index);
+    }
+#endif
+    return find_max_scalar(values, count, index);
+}
+}  // namespace custom_nodes_common
+}  // namespace ovms
@@ -0,0 +1,85 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ovms {
+namespace custom_nodes_common {
+
+/**
+ * @brief Detection proposals stored as structure of arrays.
+ * Storage is kept between clear() calls, so reused instance does not allocate in steady state.
+ */
+class DetectionProposals {
+    size_t count = 0;
+
+public:
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> width;
+    std::vector<float> height;
+    std::vector<float> score;
+    std::vector<int> classId;
+
+    void clear() {
+        count = 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    void push(float boxX, float boxY, float boxWidth, float boxHeight, float boxScore, int boxClassId) {
+        if (count == x.size()) {
+            size_t capacity = count == 0 ? 64 : 2 * count;
+            x.resize(capacity);
+            y.resize(capacity);
+            width.resize(capacity);
+            height.resize(capacity);
+            score.resize(capacity);
+            classId.resize(capacity);
+        }
+        x[count] = boxX;
+        y[count] = boxY;
+        width[count] = boxWidth;
+        height[count] = boxHeight;
+        score[count] = boxScore;
+        classId[count] = boxClassId;
+        count++;
+    }
+
+    void append(const DetectionProposals& other) {
+        for (size_t i = 0; i < other.size(); i++) {
+            push(other.x[i], other.y[i], other.width[i], other.height[i], other.score[i], other.classId[i]);
+        }
+    }
+};
+
+/**
+ * @brief Selects rows of row major matrix with value in given column larger than threshold.
+ * Writes indices of selected rows into selected (must fit rowsCount entries) and returns their number.
+ */
+size_t select_rows_above(const float* rows, size_t rowsCount, size_t rowStride, size_t column, float threshold, uint32_t* selected);
+
+/**
+ * @brief Returns maximum of count > 0 values and writes index of its first occurrence.
+ */
+float find_max(const float* values, int count, int* index);
+}  // namespace custom_nodes_common
+}  // namespace ovms
@@ -0,0 +1,817 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+
+#include "image_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMAGE_KERNELS_X86
+#endif
+
+#include "parallel.hpp"
+
+namespace ovms {
+namespace custom_nodes_common {
+
+#ifdef IMAGE_KERNELS_X86
+// Kernels are compiled for specific instruction sets with target attributes and selected at runtime,
+// so the library does not need to be built with -march flags.
+static const bool cpuHasAvx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+static const bool cpuHasAvx512 = __builtin_cpu_supports("avx512f");
+static const bool cpuHasSsse3 = __builtin_cpu_supports("ssse3");
+#endif
+
+ChannelTransform make_channel_transform(bool isScaleDefined, float scale, const std::vector<float>& meanValues, const std::vector<float>& scaleValues, int channels) {
+    ChannelTransform transform;
+    for (int c = 0; c < MAX_KERNEL_CHANNELS; c++) {
+        float multiplier = isScaleDefined ? 1.0f / scale : 1.0f;
+        float shift = 0.0f;
+        if (c < channels && c < (int)meanValues.size()) {
+            shift = -meanValues[c];
+        }
+        if (c < channels && c < (int)scaleValues.size()) {
+            multiplier /= scaleValues[c];
+            shift /= scaleValues[c];
+        }
+        transform.scale[c] = multiplier;
+        transform.shift[c] = shift;
+    }
+    return transform;
+}
+
+bool is_identity_transform(const ChannelTransform& transform, int channels) {
+    for (int c = 0; c < channels; c++) {
+        if (transform.scale[c] != 1.0f || transform.shift[c] != 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void convert_to_float_scalar(const uint8_t* source, float* destination, size_t begin, size_t count) {
+    for (size_t i = begin; i < count; i++) {
+        destination[i] = source[i];
+    }
+}
+
+#ifdef IMAGE_KERNELS_X86
+__attribute__((target("avx2"))) static size_t convert_to_float_avx2(const uint8_t* source, float* destination, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        _mm256_storeu_ps(destination + i, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)));
+        _mm256_storeu_ps(destination + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8))));
+    }
+    return i;
+}
+
+// SSE2 widening through unpacking with zero.
+static size_t convert_to_float_sse(const uint8_t* source, float* destination, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_ps(destination + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)));
+        _mm_storeu_ps(destination + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)));
+        _mm_storeu_ps(destination + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)));
+        _mm_storeu_ps(destination + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)));
+    }
+    return i;
+}
+#endif
+
+void convert_to_float(const uint8_t* source, float* destination, size_t count) {
+    size_t done = 0;
+#ifdef IMAGE_KERNELS_X86
+    done = cpuHasAvx2 ? convert_to_float_avx2(source, destination, count) : convert_to_float_sse(source, destination, count);
+#endif
+    convert_to_float_scalar(source, destination, done, count);
+}
+
+// Source index and weight for bilinear sampling, following cv::resize INTER_LINEAR pixel center mapping.
+static void compute_interpolation_table(int sourceSize, int targetSize, int* first, int* second, float* weight) {
+    double ratio = (double)sourceSize / targetSize;
+    for (int i = 0; i < targetSize; i++) {
+        float position = (float)((i + 0.5) * ratio - 0.5);
+        int index = (int)std::floor(position);
+        float fraction = position - index;
+        if (index < 0) {
+            index = 0;
+            fraction = 0.0f;
+        }
+        if (index >= sourceSize - 1) {
+            index = sourceSize - 1;
+            fraction = 0.0f;
+        }
+        first[i] = index;
+        second[i] = std::min(index + 1, sourceSize - 1);
+        weight[i] = fraction;
+    }
+}
+
+// Horizontal pass: interpolates one interleaved source row into planar rows (channels x width).
+// Offsets are premultiplied by number of channels.
+static void resize_row_horizontal_scalar(const float* source, int channels, const int* first, const int* second, const float* weight, int begin, int width, float* destination) {
+    for (int x = begin; x < width; x++) {
+        float w = weight[x];
+        for (int c = 0; c < channels; c++) {
+            float a = source[first[x] + c];
+            float b = source[second[x] + c];
+            destination[c * width + x] = a + (b - a) * w;
+        }
+    }
+}
+
+// Vertical pass with channel transform: destination = (top + (bottom - top) * w) * scale + shift
+static void blend_rows_scalar(const float* top, const float* bottom, float w, float scale, float shift, int begin, int width, float* destination) {
+    for (int x = begin; x < width; x++) {
+        destination[x] = (top[x] + (bottom[x] - top[x]) * w) * scale + shift;
+    }
+}
+
+#ifdef IMAGE_KERNELS_X86
+__attribute__((target("avx2,fma"))) static void resize_row_horizontal_avx2(const float* source, int channels, const int* first, const int* second, const float* weight, int width, float* destination) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i firstOffsets = _mm256_loadu_si256((const __m256i*)(first + x));
+        __m256i secondOffsets = _mm256_loadu_si256((const __m256i*)(second + x));
+        __m256 w = _mm256_loadu_ps(weight + x);
+        for (int c = 0; c < channels; c++) {
+            __m256i channel = _mm256_set1_epi32(c);
+            __m256 a = _mm256_i32gather_ps(source, _mm256_add_epi32(firstOffsets, channel), 4);
+            __m256 b = _mm256_i32gather_ps(source, _mm256_add_epi32(secondOffsets, channel), 4);
+            _mm256_storeu_ps(destination + c * width + x, _mm256_fmadd_ps(_mm256_sub_ps(b, a), w, a));
+        }
+    }
+    resize_row_horizontal_scalar(source, channels, first, second, weight, x, width, destination);
+}
+
+__attribute__((target("avx2,fma"))) static void blend_rows_avx2(const float* top, const float* bottom, float w, float scale, float shift, int width, float* destination) {
+    __m256 weight = _mm256_set1_ps(w);
+    __m256 multiplier = _mm256_set1_ps(scale);
+    __m256 offset = _mm256_set1_ps(shift);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256 a = _mm256_loadu_ps(top + x);
+        __m256 b = _mm256_loadu_ps(bottom + x);
+        __m256 value = _mm256_fmadd_ps(_mm256_sub_ps(b, a), weight, a);
+        _mm256_storeu_ps(destination + x, _mm256_fmadd_ps(value, multiplier, offset));
+    }
+    blend_rows_scalar(top, bottom, w, scale, shift, x, width, destination);
+}
+
+// SSE2 is part of x86-64 baseline so it does not need runtime check.
+static void blend_rows_sse(const float* top, const float* bottom, float w, float scale, float shift, int width, float* destination) {
+    __m128 weight = _mm_set1_ps(w);
+    __m128 multiplier = _mm_set1_ps(scale);
+    __m128 offset = _mm_set1_ps(shift);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128 a = _mm_loadu_ps(top + x);
+        __m128 b = _mm_loadu_ps(bottom + x);
+        __m128 value = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), weight));
+        _mm_storeu_ps(destination + x, _mm_add_ps(_mm_mul_ps(value, multiplier), offset));
+    }
+    blend_rows_scalar(top, bottom, w, scale, shift, x, width, destination);
+}
+#endif
+
+static void resize_row_horizontal(const float* source, int channels, const int* first, const int* second, const float* weight, int width, float* destination) {
+#ifdef IMAGE_KERNELS_X86
+    if (cpuHasAvx2) {
+        resize_row_horizontal_avx2(source, channels, first, second, weight, width, destination);
+        return;
+    }
+#endif
+    resize_row_horizontal_scalar(source, channels, first, second, weight, 0, width, destination);
+}
+
+static void blend_rows(const float* top, const float* bottom, float w, float scale, float shift, int width, float* destination) {
+#ifdef IMAGE_KERNELS_X86
+    if (cpuHasAvx2) {
+        blend_rows_avx2(top, bottom, w, scale, shift, width, destination);
+    } else {
+        blend_rows_sse(top, bottom, w, scale, shift, width, destination);
+    }
+#else
+    blend_rows_scalar(top, bottom, w, scale, shift, 0, width, destination);
+#endif
+}
+
+// uint8 rows are converted to float before interpolation, float rows are used in place.
+static const float* load_row(const float* source, size_t count, float* scratch) {
+    return source;
+}
+
+static const float* load_row(const uint8_t* source, size_t count, float* scratch) {
+    convert_to_float(source, scratch, count);
+    return scratch;
+}
+
+template <typename T>
+static float letterbox_nhwc_to_nchw_impl(const T* source, int sourceHeight, int sourceWidth, int channels,
+    float* destination, int targetHeight, int targetWidth,
+    bool swapRedBlue, const ChannelTransform& transform, float padValue) {
+    float ratio = std::min(targetWidth / (sourceWidth * 1.0), targetHeight / (sourceHeight * 1.0));
+    int resizedWidth = std::max(1, std::min(targetWidth, (int)(ratio * sourceWidth)));
+    int resizedHeight = std::max(1, std::min(targetHeight, (int)(ratio * sourceHeight)));
+    size_t plane = (size_t)targetHeight * targetWidth;
+
+    std::vector<int> firstColumn(resizedWidth), secondColumn(resizedWidth);
+    std::vector<float> columnWeight(resizedWidth);
+    compute_interpolation_table(sourceWidth, resizedWidth, firstColumn.data(), secondColumn.data(), columnWeight.data());
+    for (int x = 0; x < resizedWidth; x++) {
+        firstColumn[x] *= channels;
+        secondColumn[x] *= channels;
+    }
+    std::vector<int> firstRow(resizedHeight), secondRow(resizedHeight);
+    std::vector<float> rowWeight(resizedHeight);
+    compute_interpolation_table(sourceHeight, resizedHeight, firstRow.data(), secondRow.data(), rowWeight.data());
+
+    float padding[MAX_KERNEL_CHANNELS];
+    for (int c = 0; c < channels; c++) {
+        padding[c] = padValue * transform.scale[c] + transform.shift[c];
+    }
+
+    // Horizontally resized source rows are cached, consecutive target rows mostly share them.
+    std::vector<float> rows(2 * (size_t)channels * resizedWidth);
+    float* topRow = rows.data();
+    float* bottomRow = rows.data() + (size_t)channels * resizedWidth;
+    int topIndex = -1;
+    int bottomIndex = -1;
+    size_t sourceStride = (size_t)sourceWidth * channels;
+    std::vector<float> sourceRow(std::is_same<T, float>::value ? 0 : sourceStride);
+
+    for (int y = 0; y < resizedHeight; y++) {
+        int top = firstRow[y];
+        int bottom = secondRow[y];
+        if (top == bottomIndex) {
+            std::swap(topRow, bottomRow);
+            std::swap(topIndex, bottomIndex);
+        }
+        if (top != topIndex) {
+            resize_row_horizontal(load_row(source + top * sourceStride, sourceStride, sourceRow.data()), channels, firstColumn.data(), secondColumn.data(), columnWeight.data(), resizedWidth, topRow);
+            topIndex = top;
+        }
+        if (bottom != bottomIndex) {
+            resize_row_horizontal(load_row(source + bottom * sourceStride, sourceStride, sourceRow.data()), channels, firstColumn.data(), secondColumn.data(), columnWeight.data(), resizedWidth, bottomRow);
+            bottomIndex = bottom;
+        }
+        for (int c = 0; c < channels; c++) {
+            int sourceChannel = swapRedBlue ? channels - 1 - c : c;
+            float* output = destination + c * plane + (size_t)y * targetWidth;
+            blend_rows(topRow + sourceChannel * resizedWidth, bottomRow + sourceChannel * resizedWidth, rowWeight[y],
+                transform.scale[c], transform.shift[c], resizedWidth, output);
+            std::fill(output + resizedWidth, output + targetWidth, padding[c]);
+        }
+    }
+    for (int c = 0; c < channels; c++) {
+        std::fill(destination + c * plane + (size_t)resizedHeight * targetWidth, destination + (c + 1) * plane, padding[c]);
+    }
+    return ratio;
+}
+
+float letterbox_nhwc_to_nchw(const float* source, int sourceHeight, int sourceWidth, int channels,
+    float* destination, int targetHeight, int targetWidth,
+    bool swapRedBlue, const ChannelTransform& transform, float padValue) {
+    return letterbox_nhwc_to_nchw_impl(source, sourceHeight, sourceWidth, channels, destination, targetHeight, targetWidth, swapRedBlue, transform, padValue);
+}
+
+float letterbox_nhwc_to_nchw(const uint8_t* source, int sourceHeight, int sourceWidth, int channels,
+    float* destination, int targetHeight, int targetWidth,
+    bool swapRedBlue, const ChannelTransform& transform, float padValue) {
+    return letterbox_nhwc_to_nchw_impl(source, sourceHeight, sourceWidth, channels, destination, targetHeight, targetWidth, swapRedBlue, transform, padValue);
+}
+
+// Pixels are processed in blocks small enough to keep source block in L1 while each plane is written sequentially.
+static constexpr size_t REORDER_BLOCK_PIXELS = 256;
+
+// Tiled kernels handle pixels [begin, end) of image with planes of pixels values.
+template <typename T>
+static void reorder_nhwc_to_nchw_tiled(const T* source, T* destination, size_t begin, size_t end, size_t pixels, int channels) {
+    for (size_t block = begin; block < end; block += REORDER_BLOCK_PIXELS) {
+        size_t blockEnd = std::min(block + REORDER_BLOCK_PIXELS, end);
+        for (int c = 0; c < channels; c++) {
+            T* plane = destination + c * pixels;
+            for (size_t i = block; i < blockEnd; i++) {
+                plane[i] = source[i * channels + c];
+            }
+        }
+    }
+}
+
+template <typename T>
+static void reorder_nchw_to_nhwc_tiled(const T* source, T* destination, size_t begin, size_t end, size_t pixels, int channels) {
+    for (size_t block = begin; block < end; block += REORDER_BLOCK_PIXELS) {
+        size_t blockEnd = std::min(block + REORDER_BLOCK_PIXELS, end);
+        for (int c = 0; c < channels; c++) {
+            const T* plane = source + c * pixels;
+            for (size_t i = block; i < blockEnd; i++) {
+                destination[i * channels + c] = plane[i];
+            }
+        }
+    }
+}
+
+#ifdef IMAGE_KERNELS_X86
+// 3 channel kernels return number of processed pixels, remainder is handled by tiled path.
+static size_t deinterleave3_sse(const float* source, float* r, float* g, float* b, size_t pixels) {
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        __m128 p0 = _mm_loadu_ps(source + 3 * i);
+        __m128 p1 = _mm_loadu_ps(source + 3 * i + 4);
+        __m128 p2 = _mm_loadu_ps(source + 3 * i + 8);
+        __m128 red = _mm_shuffle_ps(p0, _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 green = _mm_shuffle_ps(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 0, 1, 1)), _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 blue = _mm_shuffle_ps(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(p2, p2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        _mm_storeu_ps(r + i, red);
+        _mm_storeu_ps(g + i, green);
+        _mm_storeu_ps(b + i, blue);
+    }
+    return i;
+}
+
+static size_t interleave3_sse(const float* r, const float* g, const float* b, float* destination, size_t pixels) {
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        __m128 red = _mm_loadu_ps(r + i);
+        __m128 green = _mm_loadu_ps(g + i);
+        __m128 blue = _mm_loadu_ps(b + i);
+        __m128 p0 = _mm_shuffle_ps(_mm_unpacklo_ps(red, green), _mm_shuffle_ps(blue, red, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+        __m128 p1 = _mm_shuffle_ps(_mm_shuffle_ps(green, blue, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(red, green, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 p2 = _mm_shuffle_ps(_mm_shuffle_ps(blue, red, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(green, blue, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        _mm_storeu_ps(destination + 3 * i, p0);
+        _mm_storeu_ps(destination + 3 * i + 4, p1);
+        _mm_storeu_ps(destination + 3 * i + 8, p2);
+    }
+    return i;
+}
+
+// Each output vector takes channel elements from all three input vectors at disjoint positions,
+// so it is assembled with two blends and put in order with single permutation.
+__attribute__((target("avx2"))) static size_t deinterleave3_avx2(const float* source, float* r, float* g, float* b, size_t pixels) {
+    const __m256i redOrder = _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5);
+    const __m256i greenOrder = _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6);
+    const __m256i blueOrder = _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7);
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m256 p0 = _mm256_loadu_ps(source + 3 * i);
+        __m256 p1 = _mm256_loadu_ps(source + 3 * i + 8);
+        __m256 p2 = _mm256_loadu_ps(source + 3 * i + 16);
+        __m256 red = _mm256_blend_ps(_mm256_blend_ps(p0, p1, 0x92), p2, 0x24);
+        __m256 green = _mm256_blend_ps(_mm256_blend_ps(p0, p1, 0x24), p2, 0x49);
+        __m256 blue = _mm256_blend_ps(_mm256_blend_ps(p0, p1, 0x49), p2, 0x92);
+        _mm256_storeu_ps(r + i, _mm256_permutevar8x32_ps(red, redOrder));
+        _mm256_storeu_ps(g + i, _mm256_permutevar8x32_ps(green, greenOrder));
+        _mm256_storeu_ps(b + i, _mm256_permutevar8x32_ps(blue, blueOrder));
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) static size_t interleave3_avx2(const float* r, const float* g, const float* b, float* destination, size_t pixels) {
+    const __m256i redOrder = _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5);
+    const __m256i greenOrder = _mm256_setr_epi32(5, 0, 3, 6, 1, 4, 7, 2);
+    const __m256i blueOrder = _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7);
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m256 red = _mm256_permutevar8x32_ps(_mm256_loadu_ps(r + i), redOrder);
+        __m256 green = _mm256_permutevar8x32_ps(_mm256_loadu_ps(g + i), greenOrder);
+        __m256 blue = _mm256_permutevar8x32_ps(_mm256_loadu_ps(b + i), blueOrder);
+        _mm256_storeu_ps(destination + 3 * i, _mm256_blend_ps(_mm256_blend_ps(red, green, 0x92), blue, 0x24));
+        _mm256_storeu_ps(destination + 3 * i + 8, _mm256_blend_ps(_mm256_blend_ps(red, green, 0x24), blue, 0x49));
+        _mm256_storeu_ps(destination + 3 * i + 16, _mm256_blend_ps(_mm256_blend_ps(red, green, 0x49), blue, 0x92));
+    }
+    return i;
+}
+
+// Element k of channel c is at position 3 * k + c of 48 interleaved values. Two-source permutations
+// gather positions below 32 from first two vectors, then the rest from the third one.
+__attribute__((target("avx512f"))) static size_t deinterleave3_avx512(const float* source, float* r, float* g, float* b, size_t pixels) {
+    alignas(64) int32_t firstOrder[3][16];
+    alignas(64) int32_t secondOrder[3][16];
+    for (int c = 0; c < 3; c++) {
+        for (int k = 0; k < 16; k++) {
+            int position = 3 * k + c;
+            firstOrder[c][k] = position < 32 ? position : 0;
+            secondOrder[c][k] = position < 32 ? k : 16 + position - 32;
+        }
+    }
+    __m512i first[3], second[3];
+    for (int c = 0; c < 3; c++) {
+        first[c] = _mm512_load_si512(firstOrder[c]);
+        second[c] = _mm512_load_si512(secondOrder[c]);
+    }
+    float* planes[3] = {r, g, b};
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m512 p0 = _mm512_loadu_ps(source + 3 * i);
+        __m512 p1 = _mm512_loadu_ps(source + 3 * i + 16);
+        __m512 p2 = _mm512_loadu_ps(source + 3 * i + 32);
+        for (int c = 0; c < 3; c++) {
+            __m512 partial = _mm512_permutex2var_ps(p0, first[c], p1);
+            _mm512_storeu_ps(planes[c] + i, _mm512_permutex2var_ps(partial, second[c], p2));
+        }
+    }
+    return i;
+}
+
+// Position k of output vector v holds channel (16 * v + k) % 3 of pixel (16 * v + k) / 3.
+// First permutation picks red and green values, second one fills blue positions.
+__attribute__((target("avx512f"))) static size_t interleave3_avx512(const float* r, const float* g, const float* b, float* destination, size_t pixels) {
+    alignas(64) int32_t firstOrder[3][16];
+    alignas(64) int32_t secondOrder[3][16];
+    for (int v = 0; v < 3; v++) {
+        for (int k = 0; k < 16; k++) {
+            int position = 16 * v + k;
+            int channel = position % 3;
+            int pixel = position / 3;
+            firstOrder[v][k] = channel == 0 ? pixel : (channel == 1 ? 16 + pixel : 0);
+            secondOrder[v][k] = channel == 2 ? 16 + pixel : k;
+        }
+    }
+    __m512i first[3], second[3];
+    for (int v = 0; v < 3; v++) {
+        first[v] = _mm512_load_si512(firstOrder[v]);
+        second[v] = _mm512_load_si512(secondOrder[v]);
+    }
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m512 red = _mm512_loadu_ps(r + i);
+        __m512 green = _mm512_loadu_ps(g + i);
+        __m512 blue = _mm512_loadu_ps(b + i);
+        for (int v = 0; v < 3; v++) {
+            __m512 partial = _mm512_permutex2var_ps(red, first[v], green);
+            _mm512_storeu_ps(destination + 3 * i + 16 * v, _mm512_permutex2var_ps(partial, second[v], blue));
+        }
+    }
+    return i;
+}
+
+// Byte shuffle masks for 16 pixels of 3 channel uint8 image, 0x80 zeroes the byte.
+struct Interleave3ByteMasks {
+    // [channel][source vector] for deinterleave, [destination vector][channel] for interleave
+    alignas(16) int8_t deinterleave[3][3][16];
+    alignas(16) int8_t interleave[3][3][16];
+    Interleave3ByteMasks() {
+        for (int c = 0; c < 3; c++) {
+            for (int v = 0; v < 3; v++) {
+                for (int k = 0; k < 16; k++) {
+                    int position = 3 * k + c - 16 * v;
+                    deinterleave[c][v][k] = (position >= 0 && position < 16) ? position : (int8_t)0x80;
+                    int interleavedPosition = 16 * v + k;
+                    interleave[v][c][k] = interleavedPosition % 3 == c ? interleavedPosition / 3 : (int8_t)0x80;
+                }
+            }
+        }
+    }
+};
+static const Interleave3ByteMasks byteMasks;
+
+__attribute__((target("ssse3"))) static size_t deinterleave3_ssse3(const uint8_t* source, uint8_t* r, uint8_t* g, uint8_t* b, size_t pixels) {
+    __m128i masks[3][3];
+    for (int c = 0; c < 3; c++) {
+        for (int v = 0; v < 3; v++) {
+            masks[c][v] = _mm_load_si128((const __m128i*)byteMasks.deinterleave[c][v]);
+        }
+    }
+    uint8_t* planes[3] = {r, g, b};
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m128i p0 = _mm_loadu_si128((const __m128i*)(source + 3 * i));
+        __m128i p1 = _mm_loadu_si128((const __m128i*)(source + 3 * i + 16));
+        __m128i p2 = _mm_loadu_si128((const __m128i*)(source + 3 * i + 32));
+        for (int c = 0; c < 3; c++) {
+            __m128i value = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(p0, masks[c][0]), _mm_shuffle_epi8(p1, masks[c][1])), _mm_shuffle_epi8(p2, masks[c][2]));
+            _mm_storeu_si128((__m128i*)(planes[c] + i), value);
+        }
+    }
+    return i;
+}
+
+__attribute__((target("ssse3"))) static size_t interleave3_ssse3(const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t* destination, size_t pixels) {
+    __m128i masks[3][3];
+    for (int v = 0; v < 3; v++) {
+        for (int c = 0; c < 3; c++) {
+            masks[v][c] = _mm_load_si128((const __m128i*)byteMasks.interleave[v][c]);
+        }
+    }
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m128i red = _mm_loadu_si128((const __m128i*)(r + i));
+        __m128i green = _mm_loadu_si128((const __m128i*)(g + i));
+        __m128i blue = _mm_loadu_si128((const __m128i*)(b + i));
+        for (int v = 0; v < 3; v++) {
+            __m128i value = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(red, masks[v][0]), _mm_shuffle_epi8(green, masks[v][1])), _mm_shuffle_epi8(blue, masks[v][2]));
+            _mm_storeu_si128((__m128i*)(destination + 3 * i + 16 * v), value);
+        }
+    }
+    return i;
+}
+#endif
+
+// Large images are split into row bands reordered in parallel, each band writes its own part of every plane.
+void reorder_nhwc_to_nchw(const float* source, float* destination, int rows, int cols, int channels) {
+    size_t pixels = (size_t)rows * cols;
+    if (channels == 1) {
+        std::memcpy(destination, source, pixels * sizeof(float));
+        return;
+    }
+    parallel_for_rows(rows, cols, POOL_THREADS, [=](int rowBegin, int rowEnd) {
+        size_t begin = (size_t)rowBegin * cols;
+        size_t end = (size_t)rowEnd * cols;
+        size_t done = begin;
+#ifdef IMAGE_KERNELS_X86
+        if (channels == 3) {
+            const float* in = source + begin * 3;
+            float* r = destination + begin;
+            if (cpuHasAvx512) {
+                done += deinterleave3_avx512(in, r, r + pixels, r + 2 * pixels, end - begin);
+            } else if (cpuHasAvx2) {
+                done += deinterleave3_avx2(in, r, r + pixels, r + 2 * pixels, end - begin);
+            } else {
+                done += deinterleave3_sse(in, r, r + pixels, r + 2 * pixels, end - begin);
+            }
+        }
+#endif
+        reorder_nhwc_to_nchw_tiled(source, destination, done, end, pixels, channels);
+    });
+}
+
+void reorder_nhwc_to_nchw(const uint8_t* source, uint8_t* destination, int rows, int cols, int channels) {
+    size_t pixels = (size_t)rows * cols;
+    if (channels == 1) {
+        std::memcpy(destination, source, pixels);
+        return;
+    }
+    parallel_for_rows(rows, cols, POOL_THREADS, [=](int rowBegin, int rowEnd) {
+        size_t begin = (size_t)rowBegin * cols;
+        size_t end = (size_t)rowEnd * cols;
+        size_t done = begin;
+#ifdef IMAGE_KERNELS_X86
+        if (channels == 3 && cpuHasSsse3) {
+            uint8_t* r = destination + begin;
+            done += deinterleave3_ssse3(source + begin * 3, r, r + pixels, r + 2 * pixels, end - begin);
+        }
+#endif
+        reorder_nhwc_to_nchw_tiled(source, destination, done, end, pixels, channels);
+    });
+}
+
+void reorder_nchw_to_nhwc(const float* source, float* destination, int rows, int cols, int channels) {
+    size_t pixels = (size_t)rows * cols;
+    if (channels == 1) {
+        std::memcpy(destination, source, pixels * sizeof(float));
+        return;
+    }
+    parallel_for_rows(rows, cols, POOL_THREADS, [=](int rowBegin, int rowEnd) {
+        size_t begin = (size_t)rowBegin * cols;
+        size_t end = (size_t)rowEnd * cols;
+        size_t done = begin;
+#ifdef IMAGE_KERNELS_X86
+        if (channels == 3) {
+            const float* r = source + begin;
+            float* out = destination + begin * 3;
+            if (cpuHasAvx512) {
+                done += interleave3_avx512(r, r + pixels, r + 2 * pixels, out, end - begin);
+            } else if (cpuHasAvx2) {
+                done += interleave3_avx2(r, r + pixels, r + 2 * pixels, out, end - begin);
+            } else {
+                done += interleave3_sse(r, r + pixels, r + 2 * pixels, out, end - begin);
+            }
+        }
+#endif
+        reorder_nchw_to_nhwc_tiled(source, destination, done, end, pixels, channels);
+    });
+}
+
+void reorder_nchw_to_nhwc(const uint8_t* source, uint8_t* destination, int rows, int cols, int channels) {
+    size_t pixels = (size_t)rows * cols;
+    if (channels == 1) {
+        std::memcpy(destination, source, pixels);
+        return;
+    }
+    parallel_for_rows(rows, cols, POOL_THREADS, [=](int rowBegin, int rowEnd) {
+        size_t begin = (size_t)rowBegin * cols;
+        size_t end = (size_t)rowEnd * cols;
+        size_t done = begin;
+#ifdef IMAGE_KERNELS_X86
+        if (channels == 3 && cpuHasSsse3) {
+            const uint8_t* r = source + begin;
+            done += interleave3_ssse3(r, r + pixels, r + 2 * pixels, destination + begin * 3, end - begin);
+        }
+#endif
+        reorder_nchw_to_nhwc_tiled(source, destination, done, end, pixels, channels);
+    });
+}
+
+// Interleaved transform coefficients repeat every channels * lanes values, so they are kept as channels vectors
+// of repeating pattern and the image is processed in chunks of lanes pixels.
+static void normalize_interleaved_scalar(const float* source, float* destination, size_t begin, size_t pixels, int channels, const ChannelTransform& transform) {
+    for (size_t i = begin; i < pixels; i++) {
+        for (int c = 0; c < channels; c++) {
+            destination[i * channels + c] = source[i * channels + c] * transform.scale[c] + transform.shift[c];
+        }
+    }
+}
+
+static void normalize_plane_scalar(const float* source, float* destination, size_t begin, size_t count, float scale, float shift) {
+    for (size_t i = begin; i < count; i++) {
+        destination[i] = source[i] * scale + shift;
+    }
+}
+
+#ifdef IMAGE_KERNELS_X86
+__attribute__((target("avx2,fma"))) static void normalize_interleaved_avx2(const float* source, float* destination, size_t pixels, int channels, const ChannelTransform& transform) {
+    alignas(32) float scalePattern[MAX_KERNEL_CHANNELS * 8];
+    alignas(32) float shiftPattern[MAX_KERNEL_CHANNELS * 8];
+    for (int i = 0; i < channels * 8; i++) {
+        scalePattern[i] = transform.scale[i % channels];
+        shiftPattern[i] = transform.shift[i % channels];
+    }
+    __m256 scales[MAX_KERNEL_CHANNELS], shifts[MAX_KERNEL_CHANNELS];
+    for (int v = 0; v < channels; v++) {
+        scales[v] = _mm256_load_ps(scalePattern + 8 * v);
+        shifts[v] = _mm256_load_ps(shiftPattern + 8 * v);
+    }
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        const float* in = source + i * channels;
+        float* out = destination + i * channels;
+        for (int v = 0; v < channels; v++) {
+            _mm256_storeu_ps(out + 8 * v, _mm256_fmadd_ps(_mm256_loadu_ps(in + 8 * v), scales[v], shifts[v]));
+        }
+    }
+    normalize_interleaved_scalar(source, destination, i, pixels, channels, transform);
+}
+
+static void normalize_interleaved_sse(const float* source, float* destination, size_t pixels, int channels, const ChannelTransform& transform) {
+    alignas(16) float scalePattern[MAX_KERNEL_CHANNELS * 4];
+    alignas(16) float shiftPattern[MAX_KERNEL_CHANNELS * 4];
+    for (int i = 0; i < channels * 4; i++) {
+        scalePattern[i] = transform.scale[i % channels];
+        shiftPattern[i] = transform.shift[i % channels];
+    }
+    __m128 scales[MAX_KERNEL_CHANNELS], shifts[MAX_KERNEL_CHANNELS];
+    for (int v = 0; v < channels; v++) {
+        scales[v] = _mm_load_ps(scalePattern + 4 * v);
+        shifts[v] = _mm_load_ps(shiftPattern + 4 * v);
+    }
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        const float* in = source + i * channels;
+        float* out = destination + i * channels;
+        for (int v = 0; v < channels; v++) {
+            _mm_storeu_ps(out + 4 * v, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + 4 * v), scales[v]), shifts[v]));
+        }
+    }
+    normalize_interleaved_scalar(source, destination, i, pixels, channels, transform);
+}
+
+__attribute__((target("avx2,fma"))) static void normalize_plane_avx2(const float* source, float* destination, size_t count, float scale, float shift) {
+    __m256 multiplier = _mm256_set1_ps(scale);
+    __m256 offset = _mm256_set1_ps(shift);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(destination + i, _mm256_fmadd_ps(_mm256_loadu_ps(source + i), multiplier, offset));
+    }
+    normalize_plane_scalar(source, destination, i, count, scale, shift);
+}
+
+static void normalize_plane_sse(const float* source, float* destination, size_t count, float scale, float shift) {
+    __m128 multiplier = _mm_set1_ps(scale);
+    __m128 offset = _mm_set1_ps(shift);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(destination + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(source + i), multiplier), offset));
+    }
+    normalize_plane_scalar(source, destination, i, count, scale, shift);
+}
+#endif
+
+static void normalize_plane(const float* source, float* destination, size_t count, float scale, float shift) {
+#ifdef IMAGE_KERNELS_X86
+    if (cpuHasAvx2) {
+        normalize_plane_avx2(source, destination, count, scale, shift);
+    } else {
+        normalize_plane_sse(source, destination, count, scale, shift);
+    }
+#else
+    normalize_plane_scalar(source, destination, 0, count, scale, shift);
+#endif
+}
+
+void normalize_interleaved(const float* source, float* destination, size_t pixels, int channels, const ChannelTransform& transform) {
+    if (is_identity_transform(transform, channels)) {
+        if (source != destination) {
+            std::memcpy(destination, source, pixels * channels * sizeof(float));
+        }
+        return;
+    }
+    parallel_for_bands(pixels, MIN_PIXELS_PER_BAND, POOL_THREADS, [=, &transform](size_t begin, size_t end) {
+        const float* in = source + begin * channels;
+        float* out = destination + begin * channels;
+#ifdef IMAGE_KERNELS_X86
+        if (cpuHasAvx2) {
+            normalize_interleaved_avx2(in, out, end - begin, channels, transform);
+        } else {
+            normalize_interleaved_sse(in, out, end - begin, channels, transform);
+        }
+#else
+        normalize_interleaved_scalar(in, out, 0, end - begin, channels, transform);
+#endif
+    });
+}
+
+// Transposes block of count interleaved pixels starting at pixel block into planes of pixels values and transforms it while still in cache.
+static void normalize_block_to_planes(const float* in, float* destination, size_t pixels, size_t block, size_t count, int channels, const ChannelTransform& transform) {
+    size_t done = 0;
+#ifdef IMAGE_KERNELS_X86
+    if (channels == 3) {
+        float* r = destination + block;
+        float* g = r + pixels;
+        float* b = g + pixels;
+        if (cpuHasAvx512) {
+            done = deinterleave3_avx512(in, r, g, b, count);
+        } else if (cpuHasAvx2) {
+            done = deinterleave3_avx2(in, r, g, b, count);
+        } else {
+            done = deinterleave3_sse(in, r, g, b, count);
+        }
+    }
+#endif
+    for (int c = 0; c < channels; c++) {
+        float* plane = destination + c * pixels + block;
+        for (size_t i = done; i < count; i++) {
+            plane[i] = in[i * channels + c];
+        }
+        normalize_plane(plane, plane, count, transform.scale[c], transform.shift[c]);
+    }
+}
+
+void normalize_nhwc_to_nchw(const float* source, float* destination, int rows, int cols, int channels, const ChannelTransform& transform) {
+    if (is_identity_transform(transform, channels)) {
+        reorder_nhwc_to_nchw(source, destination, rows, cols, channels);
+        return;
+    }
+    size_t pixels = (size_t)rows * cols;
+    parallel_for_rows(rows, cols, POOL_THREADS, [=, &transform](int rowBegin, int rowEnd) {
+        size_t begin = (size_t)rowBegin * cols;
+        size_t end = (size_t)rowEnd * cols;
+        if (channels == 1) {
+            normalize_plane(source + begin, destination + begin, end - begin, transform.scale[0], transform.shift[0]);
+            return;
+        }
+        for (size_t block = begin; block < end; block += REORDER_BLOCK_PIXELS) {
+            size_t count = std::min(REORDER_BLOCK_PIXELS, end - block);
+            normalize_block_to_planes(source + block * channels, destination, pixels, block, count, channels, transform);
+        }
+    });
+}
+
+// uint8 images are converted block by block into float buffer staying in L1 and then processed by float kernels.
+void normalize_interleaved(const uint8_t* source, float* destination, size_t pixels, int channels, const ChannelTransform& transform) {
+    parallel_for_bands(pixels, MIN_PIXELS_PER_BAND, POOL_THREADS, [=, &transform](size_t begin, size_t end) {
+        float converted[REORDER_BLOCK_PIXELS * MAX_KERNEL_CHANNELS];
+        for (size_t block = begin; block < end; block += REORDER_BLOCK_PIXELS) {
+            size_t count = std::min(REORDER_BLOCK_PIXELS, end - block);
+            convert_to_float(source + block * channels, converted, count * channels);
+            normalize_interleaved(converted, destination + block * channels, count, channels, transform);
+        }
+    });
+}
+
+void normalize_nhwc_to_nchw(const uint8_t* source, float* destination, int rows, int cols, int channels, const ChannelTransform& transform) {
+    size_t pixels = (size_t)rows * cols;
+    parallel_for_rows(rows, cols, POOL_THREADS, [=, &transform](int rowBegin, int rowEnd) {
+        float converted[REORDER_BLOCK_PIXELS * MAX_KERNEL_CHANNELS];
+        for (size_t block = (size_t)rowBegin * cols; block < (size_t)rowEnd * cols; block += REORDER_BLOCK_PIXELS) {
+            size_t count = std::min(REORDER_BLOCK_PIXELS, (size_t)rowEnd * cols - block);
+            convert_to_float(source + block * channels, converted, count * channels);
+            normalize_block_to_planes(converted, destination, pixels, block, count, channels, transform);
+        }
+    });
+}
+}  // namespace custom_nodes_common
+}  // namespace ovms
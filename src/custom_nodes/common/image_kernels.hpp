@@ -0,0 +1,93 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ovms {
+namespace custom_nodes_common {
+
+static constexpr int MAX_KERNEL_CHANNELS = 4;
+
+/**
+ * @brief Per channel affine transform of pixel values: value * scale[c] + shift[c]
+ * Kernels using it accept at most MAX_KERNEL_CHANNELS channels.
+ */
+struct ChannelTransform {
+    float scale[MAX_KERNEL_CHANNELS];
+    float shift[MAX_KERNEL_CHANNELS];
+};
+
+/**
+ * @brief Builds transform equivalent to scale_image(): ((value / scale) - meanValues[c]) / scaleValues[c].
+ * Empty lists and undefined scale are treated as identity.
+ */
+ChannelTransform make_channel_transform(bool isScaleDefined, float scale, const std::vector<float>& meanValues, const std::vector<float>& scaleValues, int channels);
+
+/**
+ * @brief Returns true if transform leaves pixel values unchanged.
+ */
+bool is_identity_transform(const ChannelTransform& transform, int channels);
+
+/**
+ * @brief Converts uint8 values to float.
+ */
+void convert_to_float(const uint8_t* source, float* destination, size_t count);
+
+/**
+ * @brief Applies channel transform to interleaved image in single pass.
+ * Float source and destination may point to the same buffer, uint8 source is converted to float on the fly.
+ * Large images are split into bands processed in parallel by shared thread pool, as are the layout conversions below.
+ */
+void normalize_interleaved(const float* source, float* destination, size_t pixels, int channels, const ChannelTransform& transform);
+void normalize_interleaved(const uint8_t* source, float* destination, size_t pixels, int channels, const ChannelTransform& transform);
+
+/**
+ * @brief Applies channel transform while converting interleaved NHWC image into planar NCHW layout.
+ */
+void normalize_nhwc_to_nchw(const float* source, float* destination, int rows, int cols, int channels, const ChannelTransform& transform);
+void normalize_nhwc_to_nchw(const uint8_t* source, float* destination, int rows, int cols, int channels, const ChannelTransform& transform);
+
+/**
+ * @brief Letterbox in single pass over NHWC float image.
+ * Resizes image with bilinear interpolation preserving aspect ratio into top left corner of target image,
+ * fills the rest with padValue, optionally swaps first and last channel (BGR<->RGB),
+ * applies channel transform and writes NCHW planar output.
+ * Returns resize ratio.
+ */
+float letterbox_nhwc_to_nchw(const float* source, int sourceHeight, int sourceWidth, int channels,
+    float* destination, int targetHeight, int targetWidth,
+    bool swapRedBlue, const ChannelTransform& transform, float padValue);
+float letterbox_nhwc_to_nchw(const uint8_t* source, int sourceHeight, int sourceWidth, int channels,
+    float* destination, int targetHeight, int targetWidth,
+    bool swapRedBlue, const ChannelTransform& transform, float padValue);
+
+/**
+ * @brief Converts interleaved NHWC image into planar NCHW layout.
+ * 3 channel images use SIMD kernels selected at runtime, other channel counts use tiled copy.
+ */
+void reorder_nhwc_to_nchw(const float* source, float* destination, int rows, int cols, int channels);
+void reorder_nhwc_to_nchw(const uint8_t* source, uint8_t* destination, int rows, int cols, int channels);
+
+/**
+ * @brief Converts planar NCHW image into interleaved NHWC layout.
+ */
+void reorder_nchw_to_nhwc(const float* source, float* destination, int rows, int cols, int channels);
+void reorder_nchw_to_nhwc(const uint8_t* source, uint8_t* destination, int rows, int cols, int channels);
+}  // namespace custom_nodes_common
+}  // namespace ovms
@@ -0,0 +1,195 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../custom_node_interface.h"
+#include "image_kernels.hpp"
+#include "parallel.hpp"
+#include "utils.hpp"
+
+namespace ovms {
+namespace custom_nodes_common {
+
+enum class ImageLayout {
+    NCHW,
+    NHWC
+};
+
+enum class ColorOrder {
+    BGR,
+    RGB,
+    GRAY
+};
+
+/**
+ * @brief Parameters of image preprocessing nodes, parsed and validated once in initialize().
+ */
+struct ImagePreprocessingParameters {
+    // -1 when not specified, image keeps its original size then
+    int targetImageHeight = -1;
+    int targetImageWidth = -1;
+    ColorOrder originalImageColorOrder = ColorOrder::BGR;
+    ColorOrder targetImageColorOrder = ColorOrder::BGR;
+    uint64_t targetImageColorChannels = 3;
+    // FP32 or U8, uint8 images are converted to float in final normalization step
+    CustomNodeTensorPrecision originalImagePrecision = FP32;
+    ImageLayout originalImageLayout = ImageLayout::NHWC;
+    ImageLayout targetImageLayout = ImageLayout::NHWC;
+    bool isScaleDefined = false;
+    float scale = -1;
+    std::vector<float> scaleValues;
+    std::vector<float> meanValues;
+    // scale, scaleValues and meanValues combined into per channel multiplier and offset
+    ChannelTransform transform;
+    // images in batch above this size are still processed, but their buffers are not preallocated
+    int maxBatchSize = 1;
+    int batchThreads = 1;
+    // single image is split into overlapping tiles of target size returned as batch, instead of being resized
+    bool tiling = false;
+    int tileOverlap = 0;
+    bool debugMode = false;
+};
+}  // namespace custom_nodes_common
+}  // namespace ovms
+
+bool parse_image_layout(const std::string& value, ovms::custom_nodes_common::ImageLayout& layout) {
+    using ovms::custom_nodes_common::ImageLayout;
+    if (value == "NCHW") {
+        layout = ImageLayout::NCHW;
+    } else if (value == "NHWC") {
+        layout = ImageLayout::NHWC;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_color_order(const std::string& value, ovms::custom_nodes_common::ColorOrder& colorOrder) {
+    using ovms::custom_nodes_common::ColorOrder;
+    if (value == "BGR") {
+        colorOrder = ColorOrder::BGR;
+    } else if (value == "RGB") {
+        colorOrder = ColorOrder::RGB;
+    } else if (value == "GRAY") {
+        colorOrder = ColorOrder::GRAY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_image_precision(const std::string& value, CustomNodeTensorPrecision& precision) {
+    if (value == "FP32") {
+        precision = FP32;
+    } else if (value == "U8") {
+        precision = U8;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+uint64_t image_precision_size(CustomNodeTensorPrecision precision) {
+    return precision == U8 ? sizeof(uint8_t) : sizeof(float);
+}
+
+const char* to_string(ovms::custom_nodes_common::ImageLayout layout) {
+    return layout == ovms::custom_nodes_common::ImageLayout::NCHW ? "NCHW" : "NHWC";
+}
+
+const char* to_string(ovms::custom_nodes_common::ColorOrder colorOrder) {
+    switch (colorOrder) {
+    case ovms::custom_nodes_common::ColorOrder::BGR:
+        return "BGR";
+    case ovms::custom_nodes_common::ColorOrder::RGB:
+        return "RGB";
+    case ovms::custom_nodes_common::ColorOrder::GRAY:
+        return "GRAY";
+    }
+    return "UNKNOWN";
+}
+
+// Reads parameters shared by image preprocessing nodes:
+// target_image_height, target_image_width - output size, image is not resized when not specified
+// original_image_color_order, target_image_color_order - BGR (default), RGB or GRAY, target defaults to original
+// original_image_layout, target_image_layout - NCHW or NHWC, target defaults to original
+// original_image_precision - FP32 (default) or U8, precision of input image
+// scale, scale_values, mean_values - pixel normalization
+// max_batch_size - number of images in batch buffers are preallocated for, 1 by default
+// batch_threads - number of threads processing images of batch
+// debug - additional logging
+int read_image_preprocessing_parameters(const struct CustomNodeParam* params, int paramsCount, ovms::custom_nodes_common::ImagePreprocessingParameters& parameters) {
+    using ovms::custom_nodes_common::ColorOrder;
+
+    parameters.targetImageHeight = get_int_parameter("target_image_height", params, paramsCount, -1);
+    parameters.targetImageWidth = get_int_parameter("target_image_width", params, paramsCount, -1);
+    NODE_ASSERT(parameters.targetImageHeight > 0 || parameters.targetImageHeight == -1, "target image height - when specified, must be larger than 0");
+    NODE_ASSERT(parameters.targetImageWidth > 0 || parameters.targetImageWidth == -1, "target image width - when specified, must be larger than 0");
+
+    std::string originalImageColorOrder = get_string_parameter("original_image_color_order", params, paramsCount, "BGR");
+    std::string targetImageColorOrder = get_string_parameter("target_image_color_order", params, paramsCount);
+    targetImageColorOrder = targetImageColorOrder.empty() ? originalImageColorOrder : targetImageColorOrder;
+    NODE_ASSERT(parse_color_order(originalImageColorOrder, parameters.originalImageColorOrder), "original image layout must be BGR, RGB or GRAY");
+    NODE_ASSERT(parse_color_order(targetImageColorOrder, parameters.targetImageColorOrder), "target image layout must be BGR, RGB or GRAY");
+    parameters.targetImageColorChannels = parameters.targetImageColorOrder == ColorOrder::GRAY ? 1 : 3;
+
+    std::string originalImageLayout = get_string_parameter("original_image_layout", params, paramsCount);
+    std::string targetImageLayout = get_string_parameter("target_image_layout", params, paramsCount);
+    targetImageLayout = targetImageLayout.empty() ? originalImageLayout : targetImageLayout;
+    NODE_ASSERT(parse_image_layout(originalImageLayout, parameters.originalImageLayout), "original image layout must be NCHW or NHWC");
+    NODE_ASSERT(parse_image_layout(targetImageLayout, parameters.targetImageLayout), "target image layout must be NCHW or NHWC");
+    NODE_ASSERT(parse_image_precision(get_string_parameter("original_image_precision", params, paramsCount, "FP32"), parameters.originalImagePrecision), "original image precision must be FP32 or U8");
+
+    parameters.scale = get_float_parameter("scale", params, paramsCount, parameters.isScaleDefined, -1);
+    NODE_ASSERT(parameters.scale != 0, "cannot divide by scale equal to 0");
+    parameters.scaleValues = get_float_list_parameter("scale_values", params, paramsCount);
+    for (auto scale : parameters.scaleValues) {
+        NODE_ASSERT(scale != 0, "cannot divide by scale equal to 0");
+    }
+    parameters.meanValues = get_float_list_parameter("mean_values", params, paramsCount);
+    NODE_ASSERT(parameters.scaleValues.size() == 0 || parameters.targetImageColorChannels == parameters.scaleValues.size(), "number of scale values must be equal to number of target image channels");
+    NODE_ASSERT(parameters.meanValues.size() == 0 || parameters.targetImageColorChannels == parameters.meanValues.size(), "number of mean values must be equal to number of target image channels");
+    parameters.transform = ovms::custom_nodes_common::make_channel_transform(parameters.isScaleDefined, parameters.scale,
+        parameters.meanValues, parameters.scaleValues, parameters.targetImageColorChannels);
+
+    parameters.maxBatchSize = get_int_parameter("max_batch_size", params, paramsCount, 1);
+    NODE_ASSERT(parameters.maxBatchSize > 0, "max batch size must be larger than 0");
+    parameters.batchThreads = get_int_parameter("batch_threads", params, paramsCount, ovms::custom_nodes_common::default_thread_count());
+    NODE_ASSERT(parameters.batchThreads > 0, "batch threads must be larger than 0");
+
+    parameters.debugMode = get_string_parameter("debug", params, paramsCount) == "true";
+    return 0;
+}
+
+// Reads tiling parameters of preprocessing nodes supporting it, after read_image_preprocessing_parameters:
+// tiling - when true single image is split into tiles of target size, false by default
+// tile_overlap - minimal overlap of neighbouring tiles in pixels, 64 by default
+int read_tiling_parameters(const struct CustomNodeParam* params, int paramsCount, ovms::custom_nodes_common::ImagePreprocessingParameters& parameters) {
+    parameters.tiling = get_string_parameter("tiling", params, paramsCount, "false") == "true";
+    parameters.tileOverlap = get_int_parameter("tile_overlap", params, paramsCount, 64);
+    if (!parameters.tiling) {
+        return 0;
+    }
+    NODE_ASSERT(parameters.targetImageHeight != -1 && parameters.targetImageWidth != -1, "tiling requires target image height and width");
+    NODE_ASSERT(parameters.tileOverlap >= 0 && parameters.tileOverlap < std::min(parameters.targetImageHeight, parameters.targetImageWidth),
+        "tile overlap must not be negative and must be smaller than target image size");
+    return 0;
+}
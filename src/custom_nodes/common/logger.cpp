@@ -0,0 +1,186 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#include "logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace ovms {
+namespace custom_nodes_common {
+
+static_assert((Logger::RING_CAPACITY & (Logger::RING_CAPACITY - 1)) == 0, "ring capacity must be power of 2");
+
+// background thread wakes up at least that often, producers wake it earlier when ring gets half full
+static constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(20);
+
+bool parse_log_level(const std::string& value, LogLevel& level) {
+    static const std::pair<const char*, LogLevel> levels[] = {
+        {"TRACE", LogLevel::TRACE},
+        {"DEBUG", LogLevel::DEBUG},
+        {"INFO", LogLevel::INFO},
+        {"WARNING", LogLevel::WARNING},
+        {"ERROR", LogLevel::ERROR},
+        {"OFF", LogLevel::OFF}};
+    for (const auto& [name, candidate] : levels) {
+        if (value == name) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* to_string(LogLevel level) {
+    switch (level) {
+    case LogLevel::TRACE:
+        return "trace";
+    case LogLevel::DEBUG:
+        return "debug";
+    case LogLevel::INFO:
+        return "info";
+    case LogLevel::WARNING:
+        return "warning";
+    case LogLevel::ERROR:
+        return "error";
+    case LogLevel::OFF:
+        return "off";
+    }
+    return "unknown";
+}
+
+thread_local LogSettings* LogSettings::active = nullptr;
+
+LogSettings& LogSettings::defaults() {
+    static LogSettings settings;
+    return settings;
+}
+
+// Fixed one second windows, counter reset by first message of new window.
+bool LogSettings::withinRateLimit() {
+    uint32_t limit = rateLimit.load(std::memory_order_relaxed);
+    if (limit == 0) {
+        return true;
+    }
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t window = rateWindow.load(std::memory_order_relaxed);
+    if (window != now && rateWindow.compare_exchange_strong(window, now, std::memory_order_relaxed)) {
+        rateWindowCount.store(0, std::memory_order_relaxed);
+    }
+    return rateWindowCount.fetch_add(1, std::memory_order_relaxed) < limit;
+}
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() {
+    for (size_t i = 0; i < RING_CAPACITY; i++) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+Logger::~Logger() {
+    stopping.store(true);
+    wakeup.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    drain();
+}
+
+void Logger::log(LogLevel level, const std::string& message) {
+    if (!LogSettings::current().withinRateLimit() || !enqueue(level, message)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::call_once(threadStarted, [this]() { thread = std::thread(&Logger::run, this); });
+    size_t pending = enqueuePosition.load(std::memory_order_relaxed) - written.load(std::memory_order_relaxed);
+    if (pending >= RING_CAPACITY / 2) {
+        wakeup.notify_one();
+    }
+}
+
+void Logger::flush() {
+    size_t target = enqueuePosition.load(std::memory_order_acquire);
+    while (thread.joinable() && written.load(std::memory_order_acquire) < target && !stopping.load()) {
+        wakeup.notify_one();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// Bounded multi producer queue, each slot sequence tells whether it is free for position or holds its record.
+bool Logger::enqueue(LogLevel level, const std::string& message) {
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Record* record;
+    while (true) {
+        record = &ring[position & (RING_CAPACITY - 1)];
+        size_t sequence = record->sequence.load(std::memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    record->level = level;
+    record->length = std::min(message.size(), MAX_MESSAGE_LENGTH);
+    std::memcpy(record->text, message.data(), record->length);
+    record->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+size_t Logger::drain() {
+    std::ostringstream output;
+    size_t count = 0;
+    while (true) {
+        Record& record = ring[dequeuePosition & (RING_CAPACITY - 1)];
+        if (record.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+            break;
+        }
+        output << "[" << to_string(record.level) << "] ";
+        output.write(record.text, record.length);
+        output << '\n';
+        record.sequence.store(dequeuePosition + RING_CAPACITY, std::memory_order_release);
+        dequeuePosition++;
+        count++;
+    }
+    uint64_t droppedCount = dropped.exchange(0, std::memory_order_relaxed);
+    if (droppedCount > 0) {
+        output << "[warning] " << droppedCount << " log messages dropped\n";
+    }
+    if (count > 0 || droppedCount > 0) {
+        std::cout << output.str() << std::flush;
+    }
+    written.fetch_add(count, std::memory_order_release);
+    return count;
+}
+
+void Logger::run() {
+    while (!stopping.load()) {
+        drain();
+        std::unique_lock<std::mutex> lock(wakeupMutex);
+        wakeup.wait_for(lock, DRAIN_INTERVAL);
+    }
+}
+}  // namespace custom_nodes_common
+}  // namespace ovms
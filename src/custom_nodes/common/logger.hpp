@@ -0,0 +1,162 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace ovms {
+namespace custom_nodes_common {
+
+enum class LogLevel {
+    TRACE,
+    DEBUG,
+    INFO,
+    WARNING,
+    ERROR,
+    OFF
+};
+
+bool parse_log_level(const std::string& value, LogLevel& level);
+const char* to_string(LogLevel level);
+
+// messages per second logged by node without log_rate_limit parameter
+static constexpr uint32_t DEFAULT_LOG_RATE_LIMIT = 1000;
+
+/**
+ * @brief Level and rate limit of messages of single node, owned by its internal manager.
+ * Messages are filtered by settings active on logging thread: settings of node being initialized or executed,
+ * library defaults outside of node calls. Pool threads working for node use settings of the calling thread.
+ */
+class LogSettings {
+public:
+    // Makes settings active on calling thread until destruction, previously active ones are restored afterwards.
+    class Scope {
+    public:
+        explicit Scope(LogSettings& settings) :
+            previous(active) {
+            active = &settings;
+        }
+        ~Scope() {
+            active = previous;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        LogSettings* previous;
+    };
+
+    // settings active on calling thread
+    static LogSettings& current() {
+        return active != nullptr ? *active : defaults();
+    }
+    // INFO level and DEFAULT_LOG_RATE_LIMIT, used outside of node calls
+    static LogSettings& defaults();
+
+    bool isEnabled(LogLevel level) const {
+        return level >= minimalLevel.load(std::memory_order_relaxed) && level != LogLevel::OFF;
+    }
+    void setLevel(LogLevel level) {
+        minimalLevel.store(level, std::memory_order_relaxed);
+    }
+    // maximal number of messages logged per second, 0 for no limit
+    void setRateLimit(uint32_t messagesPerSecond) {
+        rateLimit.store(messagesPerSecond, std::memory_order_relaxed);
+    }
+    // counts message against limit of current one second window
+    bool withinRateLimit();
+
+private:
+    static thread_local LogSettings* active;
+
+    std::atomic<LogLevel> minimalLevel{LogLevel::INFO};
+    std::atomic<uint32_t> rateLimit{DEFAULT_LOG_RATE_LIMIT};
+    std::atomic<int64_t> rateWindow{0};
+    std::atomic<uint32_t> rateWindowCount{0};
+};
+
+/**
+ * @brief Logger shared by all nodes of custom node library.
+ * Messages are put into lock free ring buffer and written to stdout by background thread,
+ * so executing threads never wait for console. Messages exceeding rate limit of active LogSettings or ring capacity
+ * are dropped and number of dropped messages is reported.
+ */
+class Logger {
+public:
+    static constexpr size_t RING_CAPACITY = 1024;
+    // longer messages are truncated
+    static constexpr size_t MAX_MESSAGE_LENGTH = 256;
+
+    static Logger& instance();
+
+    ~Logger();
+
+    void log(LogLevel level, const std::string& message);
+    // waits until messages logged so far are written
+    void flush();
+
+private:
+    struct Record {
+        std::atomic<size_t> sequence;
+        LogLevel level;
+        uint32_t length;
+        char text[MAX_MESSAGE_LENGTH];
+    };
+
+    Logger();
+    bool enqueue(LogLevel level, const std::string& message);
+    size_t drain();
+    void run();
+
+    std::atomic<uint64_t> dropped{0};
+
+    std::array<Record, RING_CAPACITY> ring;
+    std::atomic<size_t> enqueuePosition{0};
+    size_t dequeuePosition = 0;
+    std::atomic<size_t> written{0};
+
+    std::mutex wakeupMutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> stopping{false};
+    std::once_flag threadStarted;
+    std::thread thread;
+};
+}  // namespace custom_nodes_common
+}  // namespace ovms
+
+// Message is formatted only when level is enabled for node active on calling thread.
+#define NODE_LOG(level, msg)                                                               \
+    do {                                                                                   \
+        if (ovms::custom_nodes_common::LogSettings::current().isEnabled(level)) {          \
+            std::ostringstream nodeLogStream_;                                             \
+            nodeLogStream_ << msg;                                                         \
+            ovms::custom_nodes_common::Logger::instance().log(level, nodeLogStream_.str()); \
+        }                                                                                  \
+    } while (0)
+
+#define NODE_LOG_TRACE(msg) NODE_LOG(ovms::custom_nodes_common::LogLevel::TRACE, msg)
+#define NODE_LOG_DEBUG(msg) NODE_LOG(ovms::custom_nodes_common::LogLevel::DEBUG, msg)
+#define NODE_LOG_INFO(msg) NODE_LOG(ovms::custom_nodes_common::LogLevel::INFO, msg)
+#define NODE_LOG_WARNING(msg) NODE_LOG(ovms::custom_nodes_common::LogLevel::WARNING, msg)
+#define NODE_LOG_ERROR(msg) NODE_LOG(ovms::custom_nodes_common::LogLevel::ERROR, msg)
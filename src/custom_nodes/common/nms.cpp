@@ -0,0 +1,334 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+
+#include "nms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace ovms {
+namespace custom_nodes_common {
+
+namespace {
+// grid resolution is lowered when boxes are small compared to their extent
+constexpr int MAX_GRID_CELLS = 1 << 16;
+
+struct Box {
+    float x0, y0, x1, y1, area;
+    // horizontal shift separating classes in grid, not used for overlap to keep its precision
+    float offset;
+    // boxes of different slots never suppress each other, all boxes share slot 0 in class agnostic mode
+    int slot;
+};
+
+// Buffers reused between calls on the same thread. Candidates are addressed by rank - position in score order.
+struct NmsScratch {
+    std::vector<uint32_t> order;
+    std::vector<Box> boxes;
+    std::vector<float> scores;
+    std::vector<uint8_t> removed;
+    std::vector<uint32_t> visited;
+    std::vector<int> classSlots;
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> cellEntries;
+    std::vector<std::pair<float, uint32_t>> heap;
+};
+
+struct Grid {
+    float originX;
+    float originY;
+    float cellSize;
+    int cols;
+    int rows;
+
+    static int cellIndex(float value, int limit) {
+        if (!(value > 0)) {
+            return 0;
+        }
+        if (value >= limit - 1) {
+            return limit - 1;
+        }
+        return (int)value;
+    }
+
+    int colBegin(const Box& box) const { return cellIndex((box.x0 - originX + box.offset) / cellSize, cols); }
+    int colEnd(const Box& box) const { return cellIndex((box.x1 - originX + box.offset) / cellSize, cols); }
+    int rowBegin(const Box& box) const { return cellIndex((box.y0 - originY) / cellSize, rows); }
+    int rowEnd(const Box& box) const { return cellIndex((box.y1 - originY) / cellSize, rows); }
+};
+
+float overlap(const Box& a, const Box& b, NmsOverlap type) {
+    float interWidth = std::min(a.x1, b.x1) - std::max(a.x0, b.x0);
+    float interHeight = std::min(a.y1, b.y1) - std::max(a.y0, b.y0);
+    float inter = (interWidth > 0 && interHeight > 0) ? interWidth * interHeight : 0.0f;
+    float unionArea = a.area + b.area - inter;
+    float iou = unionArea > 0 ? inter / unionArea : 0.0f;
+    if (type == NmsOverlap::DIOU) {
+        float centerDx = (a.x0 + a.x1 - b.x0 - b.x1) * 0.5f;
+        float centerDy = (a.y0 + a.y1 - b.y0 - b.y1) * 0.5f;
+        float enclosingWidth = std::max(a.x1, b.x1) - std::min(a.x0, b.x0);
+        float enclosingHeight = std::max(a.y1, b.y1) - std::min(a.y0, b.y0);
+        float diagonal = enclosingWidth * enclosingWidth + enclosingHeight * enclosingHeight;
+        if (diagonal > 0) {
+            iou -= (centerDx * centerDx + centerDy * centerDy) / diagonal;
+        }
+    }
+    return iou;
+}
+
+// Sorts proposals by descending score (ties by index) keeping topK of them.
+size_t selectCandidates(const DetectionProposals& proposals, int topK, std::vector<uint32_t>& order) {
+    size_t count = proposals.size();
+    order.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = (uint32_t)i;
+    }
+    const float* score = proposals.score.data();
+    auto higherScore = [score](uint32_t a, uint32_t b) {
+        return score[a] > score[b] || (score[a] == score[b] && a < b);
+    };
+    if (topK > 0 && (size_t)topK < count) {
+        std::nth_element(order.begin(), order.begin() + topK, order.end(), higherScore);
+        count = topK;
+    }
+    std::sort(order.begin(), order.begin() + count, higherScore);
+    return count;
+}
+
+// Places candidates in grid covering their extent. Unless suppression is class agnostic, each class is shifted
+// horizontally by extent of all boxes, so boxes of different classes rarely share grid cells.
+// Cells on the border of neighbouring class regions may still hold both classes, so slots are compared too.
+Grid placeBoxes(const DetectionProposals& proposals, const std::vector<uint32_t>& order, size_t count, bool classAgnostic, NmsScratch& scratch) {
+    float minX = proposals.x[order[0]], minY = proposals.y[order[0]];
+    float maxX = minX, maxY = minY;
+    float sidesSum = 0;
+    int maxClassId = 0;
+    for (size_t r = 0; r < count; r++) {
+        uint32_t i = order[r];
+        float width = std::max(proposals.width[i], 0.0f);
+        float height = std::max(proposals.height[i], 0.0f);
+        minX = std::min(minX, proposals.x[i]);
+        minY = std::min(minY, proposals.y[i]);
+        maxX = std::max(maxX, proposals.x[i] + width);
+        maxY = std::max(maxY, proposals.y[i] + height);
+        sidesSum += std::max(width, height);
+        maxClassId = std::max(maxClassId, proposals.classId[i]);
+    }
+    const float classSpan = (maxX - minX) + 1.0f;
+
+    int slots = 1;
+    std::vector<int>& classSlots = scratch.classSlots;
+    if (!classAgnostic) {
+        classSlots.assign(maxClassId + 1, -1);
+        slots = 0;
+        for (size_t r = 0; r < count; r++) {
+            int classId = std::max(proposals.classId[order[r]], 0);
+            if (classSlots[classId] < 0) {
+                classSlots[classId] = slots++;
+            }
+        }
+    }
+
+    scratch.boxes.resize(count);
+    for (size_t r = 0; r < count; r++) {
+        uint32_t i = order[r];
+        int slot = classAgnostic ? 0 : classSlots[std::max(proposals.classId[i], 0)];
+        float width = std::max(proposals.width[i], 0.0f);
+        float height = std::max(proposals.height[i], 0.0f);
+        Box& box = scratch.boxes[r];
+        box.x0 = proposals.x[i];
+        box.y0 = proposals.y[i];
+        box.x1 = box.x0 + width;
+        box.y1 = box.y0 + height;
+        box.area = width * height;
+        box.offset = classSpan * slot;
+        box.slot = slot;
+    }
+
+    // cells about the size of average box, so each box is stored in few cells
+    Grid grid;
+    grid.originX = minX;
+    grid.originY = minY;
+    grid.cellSize = std::max(sidesSum / count, 1e-3f);
+    const float totalWidth = classSpan * slots;
+    const float totalHeight = (maxY - minY) + 1.0f;
+    while (true) {
+        double cols = std::ceil(totalWidth / grid.cellSize);
+        double rows = std::ceil(totalHeight / grid.cellSize);
+        if (cols * rows <= MAX_GRID_CELLS) {
+            grid.cols = std::max((int)cols, 1);
+            grid.rows = std::max((int)rows, 1);
+            break;
+        }
+        grid.cellSize *= 2;
+    }
+
+    // cell contents stored contiguously, entries of every cell in ascending rank
+    std::vector<uint32_t>& cellStart = scratch.cellStart;
+    cellStart.assign((size_t)grid.cols * grid.rows + 1, 0);
+    for (size_t r = 0; r < count; r++) {
+        const Box& box = scratch.boxes[r];
+        for (int row = grid.rowBegin(box); row <= grid.rowEnd(box); row++) {
+            for (int col = grid.colBegin(box); col <= grid.colEnd(box); col++) {
+                cellStart[row * grid.cols + col + 1]++;
+            }
+        }
+    }
+    for (size_t cell = 1; cell < cellStart.size(); cell++) {
+        cellStart[cell] += cellStart[cell - 1];
+    }
+    scratch.cellEntries.resize(cellStart.back());
+    std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+    for (size_t r = 0; r < count; r++) {
+        const Box& box = scratch.boxes[r];
+        for (int row = grid.rowBegin(box); row <= grid.rowEnd(box); row++) {
+            for (int col = grid.colBegin(box); col <= grid.colEnd(box); col++) {
+                scratch.cellEntries[fill[row * grid.cols + col]++] = (uint32_t)r;
+            }
+        }
+    }
+    return grid;
+}
+
+// Calls visit(rank) once for every not removed candidate of the same class slot sharing grid cell with candidate of given rank.
+template <typename Visitor>
+void forEachNeighbour(const Grid& grid, NmsScratch& scratch, uint32_t rank, uint32_t stamp, Visitor visit) {
+    const Box& box = scratch.boxes[rank];
+    for (int row = grid.rowBegin(box); row <= grid.rowEnd(box); row++) {
+        for (int col = grid.colBegin(box); col <= grid.colEnd(box); col++) {
+            size_t cell = row * grid.cols + col;
+            for (uint32_t e = scratch.cellStart[cell]; e < scratch.cellStart[cell + 1]; e++) {
+                uint32_t neighbour = scratch.cellEntries[e];
+                if (neighbour == rank || scratch.removed[neighbour] || scratch.visited[neighbour] == stamp || scratch.boxes[neighbour].slot != box.slot) {
+                    continue;
+                }
+                scratch.visited[neighbour] = stamp;
+                visit(neighbour);
+            }
+        }
+    }
+}
+
+float decay(const NmsOptions& options, float boxOverlap) {
+    if (boxOverlap <= 0) {
+        return 1.0f;
+    }
+    if (options.method == NmsMethod::LINEAR) {
+        return boxOverlap > options.overlapThreshold ? 1.0f - boxOverlap : 1.0f;
+    }
+    return std::exp(-(boxOverlap * boxOverlap) / options.sigma);
+}
+}  // namespace
+
+bool parse_nms_method(const std::string& value, NmsMethod& method) {
+    if (value == "hard") {
+        method = NmsMethod::HARD;
+    } else if (value == "linear") {
+        method = NmsMethod::LINEAR;
+    } else if (value == "gaussian") {
+        method = NmsMethod::GAUSSIAN;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_nms_overlap(const std::string& value, NmsOverlap& overlap) {
+    if (value == "iou") {
+        overlap = NmsOverlap::IOU;
+    } else if (value == "diou") {
+        overlap = NmsOverlap::DIOU;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void non_max_suppression(const DetectionProposals& proposals, const NmsOptions& options, std::vector<uint32_t>& picked, std::vector<float>& pickedScores) {
+    picked.clear();
+    pickedScores.clear();
+    if (proposals.size() == 0) {
+        return;
+    }
+    static thread_local NmsScratch scratch;
+    const size_t count = selectCandidates(proposals, options.topK, scratch.order);
+    const Grid grid = placeBoxes(proposals, scratch.order, count, options.classAgnostic, scratch);
+    scratch.removed.assign(count, 0);
+    scratch.visited.assign(count, 0);
+    const size_t maxOutputs = options.maxOutputs > 0 ? options.maxOutputs : count;
+    uint32_t stamp = 0;
+
+    if (options.method == NmsMethod::HARD) {
+        // greedy suppression in score order, every kept box removes lower scored overlapping ones
+        for (uint32_t rank = 0; rank < count && picked.size() < maxOutputs; rank++) {
+            if (scratch.removed[rank]) {
+                continue;
+            }
+            picked.push_back(scratch.order[rank]);
+            pickedScores.push_back(proposals.score[scratch.order[rank]]);
+            forEachNeighbour(grid, scratch, rank, ++stamp, [&](uint32_t neighbour) {
+                if (neighbour > rank && overlap(scratch.boxes[rank], scratch.boxes[neighbour], options.overlap) > options.overlapThreshold) {
+                    scratch.removed[neighbour] = 1;
+                }
+            });
+        }
+        return;
+    }
+
+    // Soft-NMS: scores change after every pick, highest remaining one is taken from heap,
+    // entries with outdated scores are skipped when popped
+    auto lowerPriority = [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+        return a.first < b.first || (a.first == b.first && a.second > b.second);
+    };
+    std::vector<std::pair<float, uint32_t>>& heap = scratch.heap;
+    scratch.scores.resize(count);
+    heap.resize(count);
+    for (uint32_t rank = 0; rank < count; rank++) {
+        scratch.scores[rank] = proposals.score[scratch.order[rank]];
+        heap[rank] = {scratch.scores[rank], rank};
+    }
+    std::make_heap(heap.begin(), heap.end(), lowerPriority);
+    while (!heap.empty() && picked.size() < maxOutputs) {
+        std::pop_heap(heap.begin(), heap.end(), lowerPriority);
+        auto [score, rank] = heap.back();
+        heap.pop_back();
+        if (scratch.removed[rank] || score != scratch.scores[rank]) {
+            continue;
+        }
+        if (score <= options.scoreThreshold) {
+            break;
+        }
+        scratch.removed[rank] = 1;
+        picked.push_back(scratch.order[rank]);
+        pickedScores.push_back(score);
+        forEachNeighbour(grid, scratch, rank, ++stamp, [&](uint32_t neighbour) {
+            float weight = decay(options, overlap(scratch.boxes[rank], scratch.boxes[neighbour], options.overlap));
+            if (weight >= 1.0f) {
+                return;
+            }
+            scratch.scores[neighbour] *= weight;
+            if (scratch.scores[neighbour] <= options.scoreThreshold) {
+                scratch.removed[neighbour] = 1;
+                return;
+            }
+            heap.push_back({scratch.scores[neighbour], neighbour});
+            std::push_heap(heap.begin(), heap.end(), lowerPriority);
+        });
+    }
+}
+}  // namespace custom_nodes_common
+}  // namespace ovms
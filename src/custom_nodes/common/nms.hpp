@@ -0,0 +1,64 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "detections.hpp"
+
+namespace ovms {
+namespace custom_nodes_common {
+
+enum class NmsMethod {
+    HARD,      // overlapping boxes are removed
+    LINEAR,    // Soft-NMS, score multiplied by (1 - overlap) when overlap exceeds threshold
+    GAUSSIAN   // Soft-NMS, score multiplied by exp(-overlap^2 / sigma)
+};
+
+enum class NmsOverlap {
+    IOU,
+    DIOU  // IoU penalized by normalized distance of box centers
+};
+
+struct NmsOptions {
+    NmsMethod method = NmsMethod::HARD;
+    NmsOverlap overlap = NmsOverlap::IOU;
+    float overlapThreshold = 0.5f;
+    // Soft-NMS drops boxes with decayed score not larger than this
+    float scoreThreshold = 0.0f;
+    float sigma = 0.5f;
+    // only topK highest scoring proposals are considered, 0 for all
+    int topK = 0;
+    // selection stops after that many boxes, 0 for no limit
+    int maxOutputs = 0;
+    // when false boxes of different classes never suppress each other
+    bool classAgnostic = false;
+};
+
+bool parse_nms_method(const std::string& value, NmsMethod& method);
+bool parse_nms_overlap(const std::string& value, NmsOverlap& overlap);
+
+/**
+ * @brief Non maximum suppression over proposals.
+ * Boxes are assigned to spatial grid cells so overlap is computed only for boxes sharing a cell.
+ * Per class suppression offsets boxes of each class into separate regions of the same grid.
+ * Writes indices of selected proposals in descending order of final score, with scores decayed by Soft-NMS.
+ */
+void non_max_suppression(const DetectionProposals& proposals, const NmsOptions& options, std::vector<uint32_t>& picked, std::vector<float>& pickedScores);
+}  // namespace custom_nodes_common
+}  // namespace ovms
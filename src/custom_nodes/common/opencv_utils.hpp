@@ -15,9 +15,18 @@
 //*****************************************************************************
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <utility>
 #include <vector>
 
 #include "../../custom_node_interface.h"
+#include "image_kernels.hpp"
+#include "logger.hpp"
+#include "image_preprocessing_parameters.hpp"
+#include "parallel.hpp"
+#include "tiling.hpp"
 #include "opencv2/opencv.hpp"
 
 template <typename T>
@@ -31,6 +40,17 @@ void reorder_to_nhwc_2(const T* sourceNchwBuffer, T* destNhwcBuffer, int rows, i
     }
 }
 
+// float and uint8 images use vectorized kernels
+template <>
+inline void reorder_to_nhwc_2<float>(const float* sourceNchwBuffer, float* destNhwcBuffer, int rows, int cols, int channels) {
+    ovms::custom_nodes_common::reorder_nchw_to_nhwc(sourceNchwBuffer, destNhwcBuffer, rows, cols, channels);
+}
+
+template <>
+inline void reorder_to_nhwc_2<uint8_t>(const uint8_t* sourceNchwBuffer, uint8_t* destNhwcBuffer, int rows, int cols, int channels) {
+    ovms::custom_nodes_common::reorder_nchw_to_nhwc(sourceNchwBuffer, destNhwcBuffer, rows, cols, channels);
+}
+
 template <typename T>
 std::vector<T> reorder_to_nhwc(const T* nchwVector, int rows, int cols, int channels) {
     std::vector<T> nhwcVector(rows * cols * channels);
@@ -49,6 +69,16 @@ void reorder_to_nchw_2(const T* sourceNhwcBuffer, T* destNchwBuffer, int rows, i
     }
 }
 
+template <>
+inline void reorder_to_nchw_2<float>(const float* sourceNhwcBuffer, float* destNchwBuffer, int rows, int cols, int channels) {
+    ovms::custom_nodes_common::reorder_nhwc_to_nchw(sourceNhwcBuffer, destNchwBuffer, rows, cols, channels);
+}
+
+template <>
+inline void reorder_to_nchw_2<uint8_t>(const uint8_t* sourceNhwcBuffer, uint8_t* destNchwBuffer, int rows, int cols, int channels) {
+    ovms::custom_nodes_common::reorder_nhwc_to_nchw(sourceNhwcBuffer, destNchwBuffer, rows, cols, channels);
+}
+
 template <typename T>
 std::vector<T> reorder_to_nchw(const T* nhwcVector, int rows, int cols, int channels) {
     std::vector<T> nchwVector(rows * cols * channels);
@@ -56,23 +86,154 @@ std::vector<T> reorder_to_nchw(const T* nhwcVector, int rows, int cols, int chan
     return nchwVector;
 }
 
+// Writes continuous interleaved float image into destination in requested layout (NCHW or NHWC),
+// applying scale and mean values in the same pass.
+template <typename T>
+void write_normalized_image(const T* image, int rows, int cols, int channels, float* destination, ovms::custom_nodes_common::ImageLayout layout, const ovms::custom_nodes_common::ChannelTransform& transform) {
+    if (layout == ovms::custom_nodes_common::ImageLayout::NCHW) {
+        ovms::custom_nodes_common::normalize_nhwc_to_nchw(image, destination, rows, cols, channels, transform);
+    } else {
+        ovms::custom_nodes_common::normalize_interleaved(image, destination, (size_t)rows * cols, channels, transform);
+    }
+}
+
+// Image must be continuous CV_32F or CV_8U, uint8 pixels are converted to float.
+void write_normalized_image(const cv::Mat& image, float* destination, ovms::custom_nodes_common::ImageLayout layout, const ovms::custom_nodes_common::ChannelTransform& transform) {
+    if (image.depth() == CV_8U) {
+        write_normalized_image((const uint8_t*)image.data, image.rows, image.cols, image.channels(), destination, layout, transform);
+    } else {
+        write_normalized_image((const float*)image.data, image.rows, image.cols, image.channels(), destination, layout, transform);
+    }
+}
+
+// Non-owning view over NHWC tensor data, tensor must outlive returned Mat and must not be modified through it.
 const cv::Mat nhwc_to_mat(const CustomNodeTensor* input) {
     uint64_t height = input->dims[1];
     uint64_t width = input->dims[2];
-    return cv::Mat(height, width, CV_32FC3, input->data);
+    uint64_t channels = input->dims[3];
+    return cv::Mat(height, width, CV_32FC(channels), input->data);
 }
 
 const cv::Mat nchw_to_mat(const CustomNodeTensor* input) {
     uint64_t channels = input->dims[1];
     uint64_t rows = input->dims[2];
     uint64_t cols = input->dims[3];
-    auto nhwcVector = reorder_to_nhwc<float>((float*)input->data, rows, cols, channels);
+    cv::Mat image(rows, cols, CV_32FC(channels));
+    reorder_to_nhwc_2<float>((const float*)input->data, (float*)image.data, rows, cols, channels);
+    return image;
+}
 
-    cv::Mat image(rows, cols, CV_32FC3);
-    std::memcpy(image.data, nhwcVector.data(), nhwcVector.size() * sizeof(float));
+// Returns single FP32 or U8 image as continuous interleaved cv::Mat of the same depth.
+// NHWC data is wrapped without copying, so the Mat is read only view valid as long as data; NCHW data is reordered into new Mat.
+cv::Mat image_to_mat(const uint8_t* data, CustomNodeTensorPrecision precision, ovms::custom_nodes_common::ImageLayout layout, int rows, int cols, int channels) {
+    const int type = CV_MAKETYPE(precision == U8 ? CV_8U : CV_32F, channels);
+    if (layout != ovms::custom_nodes_common::ImageLayout::NCHW) {
+        return cv::Mat(rows, cols, type, const_cast<uint8_t*>(data));
+    }
+    cv::Mat image(rows, cols, type);
+    if (precision == U8) {
+        reorder_to_nhwc_2<uint8_t>(data, image.data, rows, cols, channels);
+    } else {
+        reorder_to_nhwc_2<float>((const float*)data, (float*)image.data, rows, cols, channels);
+    }
     return image;
 }
 
+// OpenCV color conversion code between color orders, returns false if conversion is not supported.
+bool color_conversion_code(ovms::custom_nodes_common::ColorOrder from, ovms::custom_nodes_common::ColorOrder to, int& code) {
+    using ovms::custom_nodes_common::ColorOrder;
+    static const std::map<std::pair<ColorOrder, ColorOrder>, int> colors = {
+        {{ColorOrder::GRAY, ColorOrder::BGR}, cv::COLOR_GRAY2BGR},
+        {{ColorOrder::GRAY, ColorOrder::RGB}, cv::COLOR_GRAY2RGB},
+        {{ColorOrder::BGR, ColorOrder::RGB}, cv::COLOR_BGR2RGB},
+        {{ColorOrder::BGR, ColorOrder::GRAY}, cv::COLOR_BGR2GRAY},
+        {{ColorOrder::RGB, ColorOrder::BGR}, cv::COLOR_RGB2BGR},
+        {{ColorOrder::RGB, ColorOrder::GRAY}, cv::COLOR_RGB2GRAY},
+    };
+    const auto& colorIt = colors.find({from, to});
+    if (colorIt == colors.end()) {
+        return false;
+    }
+    code = colorIt->second;
+    return true;
+}
+
+// Converts color order and resizes single image in its original precision, normalized float values are written only by final layout step.
+int transform_image(const uint8_t* source, CustomNodeTensorPrecision precision, int rows, int cols, int channels,
+    int targetRows, int targetCols, const ovms::custom_nodes_common::ImagePreprocessingParameters& parameters, float* destination) {
+    // Each step reads previous image and writes new Mat, so input tensor viewed by first image is never written.
+    // Image without color conversion and resize is normalized straight from input tensor.
+    cv::Mat image;
+    try {
+        image = image_to_mat(source, precision, parameters.originalImageLayout, rows, cols, channels);
+        if (parameters.originalImageColorOrder != parameters.targetImageColorOrder) {
+            int code = 0;
+            NODE_ASSERT(color_conversion_code(parameters.originalImageColorOrder, parameters.targetImageColorOrder, code), "unsupported color conversion");
+            cv::Mat converted;
+            cv::cvtColor(image, converted, code);
+            image = converted;
+        }
+        if (rows != targetRows || cols != targetCols) {
+            cv::Mat resized;
+            cv::resize(image, resized, cv::Size(targetCols, targetRows));
+            image = resized;
+        }
+    } catch (const cv::Exception& e) {
+        NODE_LOG_ERROR(e.what());
+        return 1;
+    }
+    NODE_ASSERT(image.total() * image.channels() == (size_t)targetRows * targetCols * parameters.targetImageColorChannels, "buffer size differs");
+
+    // Scale and mean values are applied while writing output. Bilinear resize and per channel normalization commute,
+    // so doing it once at target resolution gives the same result as scaling before or after resize.
+    write_normalized_image(image, destination, parameters.targetImageLayout, parameters.transform);
+    return 0;
+}
+
+// Splits single image into tiles without resizing, tiles are written one after another in target layout and normalized like whole images.
+// Color order is converted once for whole image, tiles extending past image border are padded with padValue.
+int tile_image(const uint8_t* source, CustomNodeTensorPrecision precision, int rows, int cols, int channels,
+    const std::vector<ovms::custom_nodes_common::Tile>& tiles, const ovms::custom_nodes_common::ImagePreprocessingParameters& parameters, float padValue, float* destination) {
+    cv::Mat image;
+    try {
+        image = image_to_mat(source, precision, parameters.originalImageLayout, rows, cols, channels);
+        if (parameters.originalImageColorOrder != parameters.targetImageColorOrder) {
+            int code = 0;
+            NODE_ASSERT(color_conversion_code(parameters.originalImageColorOrder, parameters.targetImageColorOrder, code), "unsupported color conversion");
+            cv::Mat converted;
+            cv::cvtColor(image, converted, code);
+            image = converted;
+        }
+    } catch (const cv::Exception& e) {
+        NODE_LOG_ERROR(e.what());
+        return 1;
+    }
+
+    // Tiles are independent, each one is copied into continuous image and written by single thread.
+    const size_t tileSize = (size_t)tiles[0].height * tiles[0].width * parameters.targetImageColorChannels;
+    std::atomic<int> failures{0};
+    ovms::custom_nodes_common::parallel_for(tiles.size(), parameters.batchThreads, [&](size_t i) {
+        const ovms::custom_nodes_common::Tile& tile = tiles[i];
+        const int height = std::min(tile.height, rows - tile.y);
+        const int width = std::min(tile.width, cols - tile.x);
+        try {
+            cv::Mat region = image(cv::Rect(tile.x, tile.y, width, height));
+            cv::Mat tileImage;
+            if (height == tile.height && width == tile.width) {
+                tileImage = region.isContinuous() ? region : region.clone();
+            } else {
+                tileImage = cv::Mat(tile.height, tile.width, image.type(), cv::Scalar::all(padValue));
+                region.copyTo(tileImage(cv::Rect(0, 0, width, height)));
+            }
+            write_normalized_image(tileImage, destination + i * tileSize, parameters.targetImageLayout, parameters.transform);
+        } catch (const cv::Exception& e) {
+            NODE_LOG_ERROR(e.what());
+            failures++;
+        }
+    });
+    return failures > 0 ? 1 : 0;
+}
+
 bool crop_rotate_resize(cv::Mat originalImage, cv::Mat& targetImage, cv::Rect roi, float angle, float originalTextWidth, float originalTextHeight, cv::Size targetShape) {
     try {
         // Limit roi to be in range of original image.
@@ -99,7 +260,7 @@ bool crop_rotate_resize(cv::Mat originalImage, cv::Mat& targetImage, cv::Rect ro
         }
         cv::resize(rotatedSlicedImage, targetImage, targetShape);
     } catch (const cv::Exception& e) {
-        std::cout << e.what() << std::endl;
+        NODE_LOG_ERROR(e.what());
         return false;
     }
     return true;
@@ -129,37 +290,15 @@ bool scale_image(
         return false;
     }
 
-    std::vector<cv::Mat> channels;
-    if (meanValues.size() > 0 || scaleValues.size() > 0) {
-        cv::split(image, channels);
-        if (channels.size() != colorChannels) {
-            return false;
-        }
-    } else {
-        channels.emplace_back(image);
-    }
-
-    if (isScaleDefined) {
-        for (size_t i = 0; i < channels.size(); i++) {
-            channels[i] /= scale;
-        }
-    }
-
-    for (size_t i = 0; i < meanValues.size(); i++) {
-        channels[i] -= meanValues[i];
+    // Single pass over interleaved pixels with precomputed per channel multipliers.
+    if (image.depth() != CV_32F || colorChannels > static_cast<size_t>(ovms::custom_nodes_common::MAX_KERNEL_CHANNELS)) {
+        return false;
     }
-
-    if (scaleValues.size() > 0) {
-        for (size_t i = 0; i < channels.size(); i++) {
-            channels[i] /= scaleValues[i];
-        }
-    } 
-    
-    if (channels.size() == 1) {
-        image = channels[0];
-    } else {
-        cv::merge(channels, image);
+    if (!image.isContinuous()) {
+        image = image.clone();
     }
+    auto transform = ovms::custom_nodes_common::make_channel_transform(isScaleDefined, scale, meanValues, scaleValues, colorChannels);
+    ovms::custom_nodes_common::normalize_interleaved((const float*)image.data, (float*)image.data, image.total(), colorChannels, transform);
 
     return true;
 }
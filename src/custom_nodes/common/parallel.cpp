@@ -0,0 +1,269 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#include "parallel.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "logger.hpp"
+
+namespace ovms {
+namespace custom_nodes_common {
+
+static constexpr int DEFAULT_MAX_THREADS = 4;
+static constexpr size_t NO_WORKER = std::numeric_limits<size_t>::max();
+
+// index of pool worker running on current thread
+static thread_local size_t currentWorker = NO_WORKER;
+
+namespace {
+struct PoolConfiguration {
+    int threads = 0;  // 0 for default thread count
+    bool pinning = false;
+    bool created = false;
+};
+
+std::mutex configurationMutex;
+PoolConfiguration configuration;
+
+PoolConfiguration take_configuration() {
+    std::lock_guard<std::mutex> lock(configurationMutex);
+    if (configuration.threads == 0) {
+        configuration.threads = default_thread_count();
+    }
+    configuration.created = true;
+    return configuration;
+}
+
+// State of single parallelFor call, shared with its tasks. Tasks still queued after the call returns find it closed and do nothing.
+struct ParallelJob {
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t active = 0;
+    bool closed = false;
+    std::atomic<size_t> next{0};
+};
+}  // namespace
+
+// Worker i runs on i-th cpu allowed for the process, so pinning respects cpusets of containers.
+static void pin_current_thread(size_t worker) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        NODE_LOG_WARNING("thread pool worker " << worker << " not pinned, allowed cpus unknown");
+        return;
+    }
+    size_t index = worker % CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        if (index-- > 0) {
+            continue;
+        }
+        cpu_set_t pinned;
+        CPU_ZERO(&pinned);
+        CPU_SET(cpu, &pinned);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned) != 0) {
+            NODE_LOG_WARNING("thread pool worker " << worker << " could not be pinned to cpu " << cpu);
+        }
+        return;
+    }
+}
+
+bool ThreadPool::configure(int threads, bool pinning) {
+    std::lock_guard<std::mutex> lock(configurationMutex);
+    if (configuration.created) {
+        return configuration.threads == threads && configuration.pinning == pinning;
+    }
+    configuration.threads = threads;
+    configuration.pinning = pinning;
+    return true;
+}
+
+ThreadPool& ThreadPool::instance() {
+    static const PoolConfiguration poolConfiguration = take_configuration();
+    static ThreadPool pool(poolConfiguration.threads, poolConfiguration.pinning);
+    return pool;
+}
+
+ThreadPool::ThreadPool(int threads, bool pinning) {
+    size_t workersCount = (size_t)std::max(threads, 1) - 1;
+    for (size_t i = 0; i < workersCount; i++) {
+        queues.emplace_back(std::make_unique<WorkerQueue>());
+    }
+    workers.reserve(workersCount);
+    for (size_t i = 0; i < workersCount; i++) {
+        workers.emplace_back(&ThreadPool::run, this, i, pinning);
+    }
+    NODE_LOG_DEBUG("thread pool created with " << size() << " threads" << (pinning ? ", workers pinned" : ""));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wakeupMutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Tasks pushed by worker go to its own deque, tasks of other threads are spread over all deques.
+void ThreadPool::push(Task task) {
+    size_t target = currentWorker != NO_WORKER ? currentWorker : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        // empty critical section orders the increment with waiting worker checking pending
+        std::lock_guard<std::mutex> lock(wakeupMutex);
+    }
+    wakeup.notify_one();
+}
+
+bool ThreadPool::tryRun(size_t worker) {
+    Task task;
+    {
+        std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+        if (!queues[worker]->tasks.empty()) {
+            task = std::move(queues[worker]->tasks.back());
+            queues[worker]->tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i < queues.size(); i++) {
+        WorkerQueue& victim = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    pending.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::run(size_t worker, bool pinning) {
+    currentWorker = worker;
+    if (pinning) {
+        pin_current_thread(worker);
+    }
+    while (true) {
+        if (tryRun(worker)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeupMutex);
+        wakeup.wait(lock, [this]() { return stopping || pending.load() > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, int threads, const std::function<void(size_t)>& body) {
+    size_t limit = threads == POOL_THREADS ? size() : std::min(std::max(threads, 1), size());
+    size_t helpers = std::min(limit, count);
+    helpers = helpers > 0 ? helpers - 1 : 0;
+    if (helpers == 0) {
+        for (size_t i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+    auto job = std::make_shared<ParallelJob>();
+    const std::function<void(size_t)>* work = &body;
+    auto process = [job, work, count]() {
+        for (size_t i = job->next.fetch_add(1); i < count; i = job->next.fetch_add(1)) {
+            (*work)(i);
+        }
+    };
+    // helpers log with settings of node that started parallel work, valid until all helpers finish
+    LogSettings* logSettings = &LogSettings::current();
+    for (size_t i = 0; i < helpers; i++) {
+        push([job, process, logSettings]() {
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                if (job->closed) {
+                    return;
+                }
+                job->active++;
+            }
+            {
+                LogSettings::Scope logScope(*logSettings);
+                process();
+            }
+            std::lock_guard<std::mutex> lock(job->mutex);
+            if (--job->active == 0 && job->closed) {
+                job->done.notify_one();
+            }
+        });
+    }
+    process();
+    // Helpers not started yet are not waited for, calling thread has already processed all items.
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->closed = true;
+    job->done.wait(lock, [&job]() { return job->active == 0; });
+}
+
+void parallel_for(size_t count, int threads, const std::function<void(size_t)>& body) {
+    if (count <= 1 || (threads != POOL_THREADS && threads <= 1)) {
+        for (size_t i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+    ThreadPool::instance().parallelFor(count, threads, body);
+}
+
+void parallel_for_bands(size_t count, size_t minPerBand, int threads, const std::function<void(size_t, size_t)>& body) {
+    size_t bands = count / std::max<size_t>(minPerBand, 1);
+    if (bands <= 1 || (threads != POOL_THREADS && threads <= 1)) {
+        if (count > 0) {
+            body(0, count);
+        }
+        return;
+    }
+    ThreadPool& pool = ThreadPool::instance();
+    bands = std::min(bands, (size_t)(threads == POOL_THREADS ? pool.size() : std::min(threads, pool.size())));
+    pool.parallelFor(bands, (int)bands, [&](size_t band) {
+        body(count * band / bands, count * (band + 1) / bands);
+    });
+}
+
+void parallel_for_rows(int rows, int cols, int threads, const std::function<void(int, int)>& body) {
+    size_t minRows = (MIN_PIXELS_PER_BAND + std::max(cols, 1) - 1) / std::max(cols, 1);
+    parallel_for_bands(std::max(rows, 0), minRows, threads, [&](size_t begin, size_t end) {
+        body((int)begin, (int)end);
+    });
+}
+
+int default_thread_count() {
+    int hardwareThreads = (int)std::thread::hardware_concurrency();
+    return std::max(1, std::min(hardwareThreads, DEFAULT_MAX_THREADS));
+}
+}  // namespace custom_nodes_common
+}  // namespace ovms
@@ -0,0 +1,99 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ovms {
+namespace custom_nodes_common {
+
+// Passed as threads to use all threads of shared pool.
+static constexpr int POOL_THREADS = 0;
+// Smallest number of pixels worth handing over to another thread.
+static constexpr size_t MIN_PIXELS_PER_BAND = 64 * 1024;
+
+/**
+ * @brief Thread pool shared by all nodes of custom node library, created on first parallel call.
+ * Each worker has its own task deque, it takes newest own tasks first and steals oldest tasks of other workers when idle.
+ * Calling thread always takes part in parallel work and never runs unrelated tasks while waiting,
+ * so nested parallel calls and thread local scratch buffers are safe.
+ */
+class ThreadPool {
+public:
+    // Number of threads used by the pool, calling thread included. Applies only before the pool is created,
+    // returns false if the pool is already running with different configuration.
+    static bool configure(int threads, bool pinning);
+    static ThreadPool& instance();
+
+    ~ThreadPool();
+
+    // number of threads taking part in parallel work, calling thread included
+    int size() const {
+        return (int)queues.size() + 1;
+    }
+
+    void parallelFor(size_t count, int threads, const std::function<void(size_t)>& body);
+
+private:
+    using Task = std::function<void()>;
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    ThreadPool(int threads, bool pinning);
+    void push(Task task);
+    bool tryRun(size_t worker);
+    void run(size_t worker, bool pinning);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> nextQueue{0};
+    std::mutex wakeupMutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+};
+
+/**
+ * @brief Runs body for each index in [0, count) using up to threads threads of shared pool, calling thread included.
+ * Indexes are handed out dynamically, so items of different cost are balanced. Returns after all items are done.
+ */
+void parallel_for(size_t count, int threads, const std::function<void(size_t)>& body);
+
+/**
+ * @brief Splits [0, count) into continuous bands of at least minPerBand items processed in parallel.
+ * Small ranges are processed by calling thread without touching the pool.
+ */
+void parallel_for_bands(size_t count, size_t minPerBand, int threads, const std::function<void(size_t, size_t)>& body);
+
+/**
+ * @brief Splits image of rows x cols pixels into bands of whole rows with at least MIN_PIXELS_PER_BAND pixels each.
+ */
+void parallel_for_rows(int rows, int cols, int threads, const std::function<void(int, int)>& body);
+
+// Default number of threads used by nodes for parallel work when not configured.
+int default_thread_count();
+}  // namespace custom_nodes_common
+}  // namespace ovms
@@ -0,0 +1,62 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include "../../custom_node_interface.h"
+#include "utils.hpp"
+
+// Helpers for nodes implementing executeInto, outputs preallocated by caller are looked up by name.
+
+// Returns true if node can write each of preallocated outputs, names lists outputs supporting preallocation.
+bool preallocated_outputs_supported(const struct CustomNodeTensor* preallocatedOutputs, int preallocatedOutputsCount, std::initializer_list<const char*> names) {
+    for (int i = 0; i < preallocatedOutputsCount; i++) {
+        bool supported = false;
+        for (const char* name : names) {
+            supported = supported || std::strcmp(preallocatedOutputs[i].name, name) == 0;
+        }
+        if (!supported) {
+            NODE_LOG_ERROR("output " << preallocatedOutputs[i].name << " cannot be written into preallocated memory");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns output preallocated by caller or nullptr when output is allocated by node.
+struct CustomNodeTensor* find_preallocated_output(struct CustomNodeTensor* preallocatedOutputs, int preallocatedOutputsCount, const char* name) {
+    for (int i = 0; i < preallocatedOutputsCount; i++) {
+        if (std::strcmp(preallocatedOutputs[i].name, name) == 0) {
+            return preallocatedOutputs + i;
+        }
+    }
+    return nullptr;
+}
+
+// Checks capacity of preallocated output and writes its shape, precision and size. Data is written later by node.
+bool prepare_preallocated_output(struct CustomNodeTensor& output, uint64_t dataBytes, const uint64_t* shape, uint64_t dimsCount, CustomNodeTensorPrecision precision) {
+    if (output.data == nullptr || output.dataBytes < dataBytes || output.dims == nullptr || output.dimsCount < dimsCount) {
+        NODE_LOG_ERROR("preallocated output " << output.name << " is too small, " << dataBytes << " bytes and " << dimsCount << " dims required");
+        return false;
+    }
+    std::copy(shape, shape + dimsCount, output.dims);
+    output.dimsCount = dimsCount;
+    output.dataBytes = dataBytes;
+    output.precision = precision;
+    return true;
+}
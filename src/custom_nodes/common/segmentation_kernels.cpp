@@ -0,0 +1,302 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#include "segmentation_kernels.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEGMENTATION_KERNELS_X86
+#endif
+
+#include "parallel.hpp"
+
+namespace ovms {
+namespace custom_nodes_common {
+
+#ifdef SEGMENTATION_KERNELS_X86
+static const bool cpuHasAvx2 = __builtin_cpu_supports("avx2");
+static const bool cpuHasAvx512 = __builtin_cpu_supports("avx512f");
+#endif
+
+static void argmax_planar_scalar(const float* scores, size_t planeSize, int channels, size_t begin, size_t end, uint8_t* classes) {
+    for (size_t i = begin; i < end; i++) {
+        float maximum = scores[i];
+        int maximumIndex = 0;
+        for (int c = 1; c < channels; c++) {
+            float value = scores[c * planeSize + i];
+            if (value > maximum) {
+                maximum = value;
+                maximumIndex = c;
+            }
+        }
+        classes[i] = (uint8_t)maximumIndex;
+    }
+}
+
+static void argmax_interleaved_scalar(const float* scores, int channels, size_t begin, size_t end, uint8_t* classes) {
+    for (size_t i = begin; i < end; i++) {
+        const float* pixel = scores + i * channels;
+        float maximum = pixel[0];
+        int maximumIndex = 0;
+        for (int c = 1; c < channels; c++) {
+            if (pixel[c] > maximum) {
+                maximum = pixel[c];
+                maximumIndex = c;
+            }
+        }
+        classes[i] = (uint8_t)maximumIndex;
+    }
+}
+
+#ifdef SEGMENTATION_KERNELS_X86
+// Running maximum of 8 pixels is compared with each plane, index of planes with strictly larger value is blended in.
+__attribute__((target("avx2"))) static size_t argmax_planar_avx2(const float* scores, size_t planeSize, int channels, size_t begin, size_t end, uint8_t* classes) {
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 maximum = _mm256_loadu_ps(scores + i);
+        __m256 maximumIndex = _mm256_setzero_ps();
+        for (int c = 1; c < channels; c++) {
+            __m256 value = _mm256_loadu_ps(scores + c * planeSize + i);
+            __m256 larger = _mm256_cmp_ps(value, maximum, _CMP_GT_OQ);
+            maximum = _mm256_blendv_ps(maximum, value, larger);
+            maximumIndex = _mm256_blendv_ps(maximumIndex, _mm256_castsi256_ps(_mm256_set1_epi32(c)), larger);
+        }
+        __m256i indices = _mm256_castps_si256(maximumIndex);
+        __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(indices), _mm256_extracti128_si256(indices, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(classes + i), _mm_packus_epi16(words, words));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) static size_t argmax_planar_avx512(const float* scores, size_t planeSize, int channels, size_t begin, size_t end, uint8_t* classes) {
+    size_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        __m512 maximum = _mm512_loadu_ps(scores + i);
+        __m512i maximumIndex = _mm512_setzero_si512();
+        for (int c = 1; c < channels; c++) {
+            __m512 value = _mm512_loadu_ps(scores + c * planeSize + i);
+            __mmask16 larger = _mm512_cmp_ps_mask(value, maximum, _CMP_GT_OQ);
+            maximum = _mm512_mask_mov_ps(maximum, larger, value);
+            maximumIndex = _mm512_mask_mov_epi32(maximumIndex, larger, _mm512_set1_epi32(c));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(classes + i), _mm512_mask_cvtepi32_epi8(_mm_setzero_si128(), 0xFFFF, maximumIndex));
+    }
+    return i;
+}
+
+// Same running maximum as planar kernels, scores of consecutive pixels for each class are gathered with channels stride.
+__attribute__((target("avx2"))) static size_t argmax_interleaved_avx2(const float* scores, int channels, size_t begin, size_t end, uint8_t* classes) {
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(channels));
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        const float* pixels = scores + i * channels;
+        __m256 maximum = _mm256_i32gather_ps(pixels, offsets, 4);
+        __m256 maximumIndex = _mm256_setzero_ps();
+        for (int c = 1; c < channels; c++) {
+            __m256 value = _mm256_i32gather_ps(pixels + c, offsets, 4);
+            __m256 larger = _mm256_cmp_ps(value, maximum, _CMP_GT_OQ);
+            maximum = _mm256_blendv_ps(maximum, value, larger);
+            maximumIndex = _mm256_blendv_ps(maximumIndex, _mm256_castsi256_ps(_mm256_set1_epi32(c)), larger);
+        }
+        __m256i indices = _mm256_castps_si256(maximumIndex);
+        __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(indices), _mm256_extracti128_si256(indices, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(classes + i), _mm_packus_epi16(words, words));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) static size_t argmax_interleaved_avx512(const float* scores, int channels, size_t begin, size_t end, uint8_t* classes) {
+    const __m512i offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(channels));
+    size_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        const float* pixels = scores + i * channels;
+        __m512 maximum = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, offsets, pixels, 4);
+        __m512i maximumIndex = _mm512_setzero_si512();
+        for (int c = 1; c < channels; c++) {
+            __m512 value = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, offsets, pixels + c, 4);
+            __mmask16 larger = _mm512_cmp_ps_mask(value, maximum, _CMP_GT_OQ);
+            maximum = _mm512_mask_mov_ps(maximum, larger, value);
+            maximumIndex = _mm512_mask_mov_epi32(maximumIndex, larger, _mm512_set1_epi32(c));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(classes + i), _mm512_mask_cvtepi32_epi8(_mm_setzero_si128(), 0xFFFF, maximumIndex));
+    }
+    return i;
+}
+#endif
+
+void argmax_planar(const float* scores, size_t planeSize, int channels, size_t begin, size_t end, uint8_t* classes) {
+    size_t done = begin;
+#ifdef SEGMENTATION_KERNELS_X86
+    if (cpuHasAvx512) {
+        done = argmax_planar_avx512(scores, planeSize, channels, begin, end, classes);
+    } else if (cpuHasAvx2) {
+        done = argmax_planar_avx2(scores, planeSize, channels, begin, end, classes);
+    }
+#endif
+    argmax_planar_scalar(scores, planeSize, channels, done, end, classes);
+}
+
+void argmax_interleaved(const float* scores, int channels, size_t begin, size_t end, uint8_t* classes) {
+    size_t done = begin;
+#ifdef SEGMENTATION_KERNELS_X86
+    if (cpuHasAvx512) {
+        done = argmax_interleaved_avx512(scores, channels, begin, end, classes);
+    } else if (cpuHasAvx2) {
+        done = argmax_interleaved_avx2(scores, channels, begin, end, classes);
+    }
+#endif
+    argmax_interleaved_scalar(scores, channels, done, end, classes);
+}
+
+static void argmax_band(const float* scores, ScoresLayout layout, size_t planeSize, int channels, size_t begin, size_t end, uint8_t* classes) {
+    if (layout == ScoresLayout::NCHW) {
+        argmax_planar(scores, planeSize, channels, begin, end, classes);
+    } else {
+        argmax_interleaved(scores, channels, begin, end, classes);
+    }
+}
+
+void argmax_mask(const float* scores, ScoresLayout layout, int rows, int cols, int channels, uint8_t* classes, int threads) {
+    const size_t planeSize = (size_t)rows * cols;
+    parallel_for_rows(rows, cols, threads, [=](int rowBegin, int rowEnd) {
+        argmax_band(scores, layout, planeSize, channels, (size_t)rowBegin * cols, (size_t)rowEnd * cols, classes);
+    });
+}
+
+// Source coordinate of target pixel center, same as cv::resize bilinear interpolation.
+static void bilinear_coefficients(int sourceSize, int targetSize, int index, int& first, int& second, float& weight) {
+    float position = std::max((index + 0.5f) * ((float)sourceSize / targetSize) - 0.5f, 0.0f);
+    first = std::min((int)position, sourceSize - 1);
+    second = std::min(first + 1, sourceSize - 1);
+    weight = position - first;
+}
+
+// blended holds planar row of cols scores for each class
+static void argmax_blended_row_scalar(const float* blended, int cols, int channels, const int* left, const int* right, const float* weights, int begin, int end, uint8_t* classes) {
+    for (int x = begin; x < end; x++) {
+        float maximum = blended[left[x]] + (blended[right[x]] - blended[left[x]]) * weights[x];
+        int maximumIndex = 0;
+        for (int c = 1; c < channels; c++) {
+            const float* row = blended + (size_t)c * cols;
+            float value = row[left[x]] + (row[right[x]] - row[left[x]]) * weights[x];
+            if (value > maximum) {
+                maximum = value;
+                maximumIndex = c;
+            }
+        }
+        classes[x] = (uint8_t)maximumIndex;
+    }
+}
+
+#ifdef SEGMENTATION_KERNELS_X86
+// Horizontal interpolation of 8 target pixels at once, blended row values are gathered for each class.
+__attribute__((target("avx2"))) static int argmax_blended_row_avx2(const float* blended, int cols, int channels, const int* left, const int* right, const float* weights, int targetCols, uint8_t* classes) {
+    int x = 0;
+    for (; x + 8 <= targetCols; x += 8) {
+        const __m256i leftIndices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + x));
+        const __m256i rightIndices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + x));
+        const __m256 weight = _mm256_loadu_ps(weights + x);
+        __m256 maximum = _mm256_setzero_ps();
+        __m256 maximumIndex = _mm256_setzero_ps();
+        for (int c = 0; c < channels; c++) {
+            const float* row = blended + (size_t)c * cols;
+            __m256 leftValues = _mm256_i32gather_ps(row, leftIndices, 4);
+            __m256 rightValues = _mm256_i32gather_ps(row, rightIndices, 4);
+            __m256 value = _mm256_add_ps(leftValues, _mm256_mul_ps(_mm256_sub_ps(rightValues, leftValues), weight));
+            if (c == 0) {
+                maximum = value;
+                continue;
+            }
+            __m256 larger = _mm256_cmp_ps(value, maximum, _CMP_GT_OQ);
+            maximum = _mm256_blendv_ps(maximum, value, larger);
+            maximumIndex = _mm256_blendv_ps(maximumIndex, _mm256_castsi256_ps(_mm256_set1_epi32(c)), larger);
+        }
+        __m256i indices = _mm256_castps_si256(maximumIndex);
+        __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(indices), _mm256_extracti128_si256(indices, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(classes + x), _mm_packus_epi16(words, words));
+    }
+    return x;
+}
+#endif
+
+void argmax_resized_bilinear(const float* scores, ScoresLayout layout, int rows, int cols, int channels, uint8_t* classes, int targetRows, int targetCols, int threads) {
+    std::vector<int> left(targetCols);
+    std::vector<int> right(targetCols);
+    std::vector<float> weights(targetCols);
+    for (int x = 0; x < targetCols; x++) {
+        bilinear_coefficients(cols, targetCols, x, left[x], right[x], weights[x]);
+    }
+    const size_t planeSize = (size_t)rows * cols;
+    parallel_for_rows(targetRows, targetCols, threads, [&](int rowBegin, int rowEnd) {
+        std::vector<float> blended((size_t)channels * cols);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            int top, bottom;
+            float weight;
+            bilinear_coefficients(rows, targetRows, y, top, bottom, weight);
+            // vertical interpolation of two source rows into planar row
+            for (int c = 0; c < channels; c++) {
+                float* blendedRow = blended.data() + (size_t)c * cols;
+                if (layout == ScoresLayout::NCHW) {
+                    const float* topRow = scores + c * planeSize + (size_t)top * cols;
+                    const float* bottomRow = scores + c * planeSize + (size_t)bottom * cols;
+                    for (int x = 0; x < cols; x++) {
+                        blendedRow[x] = topRow[x] + (bottomRow[x] - topRow[x]) * weight;
+                    }
+                } else {
+                    const float* topRow = scores + (size_t)top * cols * channels + c;
+                    const float* bottomRow = scores + (size_t)bottom * cols * channels + c;
+                    for (int x = 0; x < cols; x++) {
+                        blendedRow[x] = topRow[x * channels] + (bottomRow[x * channels] - topRow[x * channels]) * weight;
+                    }
+                }
+            }
+            uint8_t* classesRow = classes + (size_t)y * targetCols;
+            int done = 0;
+#ifdef SEGMENTATION_KERNELS_X86
+            if (cpuHasAvx2) {
+                done = argmax_blended_row_avx2(blended.data(), cols, channels, left.data(), right.data(), weights.data(), targetCols, classesRow);
+            }
+#endif
+            argmax_blended_row_scalar(blended.data(), cols, channels, left.data(), right.data(), weights.data(), done, targetCols, classesRow);
+        }
+    });
+}
+
+size_t count_runs(const uint8_t* mask, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    size_t runs = 1;
+    for (size_t i = 1; i < size; i++) {
+        runs += mask[i] != mask[i - 1];
+    }
+    return runs;
+}
+
+void encode_runs(const uint8_t* mask, size_t size, int32_t* runs) {
+    size_t start = 0;
+    for (size_t i = 1; i <= size; i++) {
+        if (i == size || mask[i] != mask[start]) {
+            *runs++ = mask[start];
+            *runs++ = (int32_t)(i - start);
+            start = i;
+        }
+    }
+}
+}  // namespace custom_nodes_common
+}  // namespace ovms
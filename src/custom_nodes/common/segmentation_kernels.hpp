@@ -0,0 +1,70 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ovms {
+namespace custom_nodes_common {
+
+// class indices are written as uint8_t
+static constexpr int MAX_ARGMAX_CLASSES = 256;
+
+enum class ScoresLayout {
+    NCHW,  // planar, one plane of class scores per class
+    NHWC   // interleaved, class scores of each pixel stored together
+};
+
+/**
+ * @brief Per pixel argmax over channels of planar (CHW) class scores.
+ * Handles pixels [begin, end) of each plane of planeSize pixels and writes class index of first maximum into classes[begin, end).
+ * SIMD kernels processing 8 or 16 pixels at once are selected at runtime.
+ */
+void argmax_planar(const float* scores, size_t planeSize, int channels, size_t begin, size_t end, uint8_t* classes);
+
+/**
+ * @brief Per pixel argmax over channels of interleaved (HWC) class scores.
+ * Handles pixels [begin, end) and writes class index of first maximum into classes[begin, end).
+ * SIMD kernels gathering scores of 8 or 16 pixels at once are selected at runtime.
+ */
+void argmax_interleaved(const float* scores, int channels, size_t begin, size_t end, uint8_t* classes);
+
+/**
+ * @brief Per pixel argmax over whole rows x cols mask in given layout.
+ * Large masks are split into row bands processed by up to threads threads of shared pool.
+ */
+void argmax_mask(const float* scores, ScoresLayout layout, int rows, int cols, int channels, uint8_t* classes, int threads);
+
+/**
+ * @brief Per pixel argmax of class scores bilinearly resized from rows x cols to targetRows x targetCols.
+ * Pixel centers are mapped like in cv::resize. Resized scores are never stored for whole image,
+ * each target row interpolates two source rows into single row buffer.
+ */
+void argmax_resized_bilinear(const float* scores, ScoresLayout layout, int rows, int cols, int channels, uint8_t* classes, int targetRows, int targetCols, int threads);
+
+/**
+ * @brief Returns number of runs of equal values in mask.
+ */
+size_t count_runs(const uint8_t* mask, size_t size);
+
+/**
+ * @brief Run length encoding of mask, writes (value, length) pair for each run in order of mask.
+ * runs must fit 2 * count_runs() values.
+ */
+void encode_runs(const uint8_t* mask, size_t size, int32_t* runs);
+}  // namespace custom_nodes_common
+}  // namespace ovms
@@ -0,0 +1,149 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#include "tiling.hpp"
+
+#include <algorithm>
+
+namespace ovms {
+namespace custom_nodes_common {
+
+std::vector<int> tile_offsets(int size, int tileSize, int overlap) {
+    if (size <= tileSize) {
+        return {0};
+    }
+    const int stride = tileSize - overlap;
+    const int count = (size - tileSize + stride - 1) / stride + 1;
+    std::vector<int> offsets(count);
+    for (int i = 0; i < count - 1; i++) {
+        offsets[i] = i * stride;
+    }
+    offsets[count - 1] = size - tileSize;
+    return offsets;
+}
+
+std::vector<Tile> compute_tiles(int rows, int cols, int tileRows, int tileCols, int overlap) {
+    std::vector<int> ys = tile_offsets(rows, tileRows, overlap);
+    std::vector<int> xs = tile_offsets(cols, tileCols, overlap);
+    std::vector<Tile> tiles;
+    tiles.reserve(ys.size() * xs.size());
+    for (int y : ys) {
+        for (int x : xs) {
+            tiles.push_back(Tile{y, x, tileRows, tileCols});
+        }
+    }
+    return tiles;
+}
+
+void write_tile_info(const std::vector<Tile>& tiles, int rows, int cols, int32_t* info) {
+    for (const Tile& tile : tiles) {
+        info[0] = tile.y;
+        info[1] = tile.x;
+        info[2] = tile.height;
+        info[3] = tile.width;
+        info[4] = rows;
+        info[5] = cols;
+        info += TILE_INFO_SIZE;
+    }
+}
+
+static std::vector<int> unique_offsets(const std::vector<Tile>& tiles, int Tile::*offset) {
+    std::vector<int> offsets;
+    offsets.reserve(tiles.size());
+    for (const Tile& tile : tiles) {
+        offsets.push_back(tile.*offset);
+    }
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+    return offsets;
+}
+
+// first tile starts at 0, each next one starts before previous one ends and last one reaches end of axis
+static bool covers_axis(const std::vector<int>& offsets, int tileSize, int size) {
+    if (offsets.front() != 0 || offsets.back() + tileSize < size || offsets.back() >= size) {
+        return false;
+    }
+    for (size_t i = 1; i < offsets.size(); i++) {
+        if (offsets[i] > offsets[i - 1] + tileSize) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool read_tile_info(const int32_t* info, size_t tilesCount, std::vector<Tile>& tiles, int& rows, int& cols) {
+    if (tilesCount == 0) {
+        return false;
+    }
+    rows = info[4];
+    cols = info[5];
+    tiles.resize(tilesCount);
+    for (size_t i = 0; i < tilesCount; i++) {
+        const int32_t* tileInfo = info + i * TILE_INFO_SIZE;
+        tiles[i] = Tile{tileInfo[0], tileInfo[1], tileInfo[2], tileInfo[3]};
+        if (tileInfo[4] != rows || tileInfo[5] != cols || tiles[i].height != tiles[0].height || tiles[i].width != tiles[0].width ||
+            tiles[i].y < 0 || tiles[i].x < 0) {
+            return false;
+        }
+    }
+    if (rows <= 0 || cols <= 0 || tiles[0].height <= 0 || tiles[0].width <= 0) {
+        return false;
+    }
+    std::vector<int> ys = unique_offsets(tiles, &Tile::y);
+    std::vector<int> xs = unique_offsets(tiles, &Tile::x);
+    if (ys.size() * xs.size() != tilesCount || !covers_axis(ys, tiles[0].height, rows) || !covers_axis(xs, tiles[0].width, cols)) {
+        return false;
+    }
+    // each grid position taken once, with matching count no position is missing
+    std::vector<uint8_t> taken(tilesCount, 0);
+    for (const Tile& tile : tiles) {
+        size_t row = std::lower_bound(ys.begin(), ys.end(), tile.y) - ys.begin();
+        size_t col = std::lower_bound(xs.begin(), xs.end(), tile.x) - xs.begin();
+        uint8_t& position = taken[row * xs.size() + col];
+        if (position) {
+            return false;
+        }
+        position = 1;
+    }
+    return true;
+}
+
+// Tile i of axis owns [begins[i], begins[i + 1]), boundary lies in the middle of overlap of neighbouring tiles.
+static std::vector<int> owned_begins(const std::vector<int>& offsets, int tileSize, int size) {
+    std::vector<int> begins(offsets.size() + 1);
+    begins[0] = 0;
+    for (size_t i = 1; i < offsets.size(); i++) {
+        begins[i] = (offsets[i] + std::min(offsets[i - 1] + tileSize, size)) / 2;
+    }
+    begins[offsets.size()] = size;
+    return begins;
+}
+
+std::vector<Tile> owned_regions(const std::vector<Tile>& tiles, int rows, int cols) {
+    std::vector<int> ys = unique_offsets(tiles, &Tile::y);
+    std::vector<int> xs = unique_offsets(tiles, &Tile::x);
+    std::vector<int> rowBegins = owned_begins(ys, tiles[0].height, rows);
+    std::vector<int> colBegins = owned_begins(xs, tiles[0].width, cols);
+    std::vector<Tile> regions;
+    regions.reserve(tiles.size());
+    for (const Tile& tile : tiles) {
+        size_t row = std::lower_bound(ys.begin(), ys.end(), tile.y) - ys.begin();
+        size_t col = std::lower_bound(xs.begin(), xs.end(), tile.x) - xs.begin();
+        regions.push_back(Tile{rowBegins[row], colBegins[col], rowBegins[row + 1] - rowBegins[row], colBegins[col + 1] - colBegins[col]});
+    }
+    return regions;
+}
+}  // namespace custom_nodes_common
+}  // namespace ovms
@@ -0,0 +1,70 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ovms {
+namespace custom_nodes_common {
+
+// tile info tensor holds one row per tile: y, x, tile height, tile width, image height, image width
+static constexpr int TILE_INFO_SIZE = 6;
+
+/**
+ * @brief Region of image covered by single tile, y and x are position of its top left corner.
+ * All tiles of image have the same size, tile of image smaller than tile size extends past image border.
+ */
+struct Tile {
+    int y;
+    int x;
+    int height;
+    int width;
+};
+
+/**
+ * @brief Offsets of tiles along single axis. Neighbouring tiles overlap by at least overlap pixels
+ * and last tile ends at image border. Axis not longer than tile is covered by single tile at offset 0.
+ * overlap must be smaller than tileSize.
+ */
+std::vector<int> tile_offsets(int size, int tileSize, int overlap);
+
+/**
+ * @brief Tiles of tileRows x tileCols covering rows x cols image, in row major order of the tile grid.
+ */
+std::vector<Tile> compute_tiles(int rows, int cols, int tileRows, int tileCols, int overlap);
+
+/**
+ * @brief Writes TILE_INFO_SIZE values for each tile.
+ */
+void write_tile_info(const std::vector<Tile>& tiles, int rows, int cols, int32_t* info);
+
+/**
+ * @brief Reads tiles and image size from tile info of tilesCount tiles.
+ * Returns false unless tiles have the same size and form a grid covering the image without gaps,
+ * with every grid position taken by exactly one tile.
+ */
+bool read_tile_info(const int32_t* info, size_t tilesCount, std::vector<Tile>& tiles, int& rows, int& cols);
+
+/**
+ * @brief Parts of image taken from each tile when tile results are stitched together.
+ * Overlapping neighbours split their overlap in the middle, so regions cover the image exactly once.
+ * Tiles must be a grid accepted by read_tile_info.
+ */
+std::vector<Tile> owned_regions(const std::vector<Tile>& tiles, int rows, int cols);
+}  // namespace custom_nodes_common
+}  // namespace ovms
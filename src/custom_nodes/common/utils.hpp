@@ -15,6 +15,8 @@
 //*****************************************************************************
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <sstream>
@@ -22,16 +24,18 @@
 #include <vector>
 
 #include "../../custom_node_interface.h"
+#include "logger.hpp"
+#include "parallel.hpp"
 
-#define NODE_ASSERT(cond, msg)                                            \
-    if (!(cond)) {                                                        \
-        std::cout << "[" << __LINE__ << "] Assert: " << msg << std::endl; \
-        return 1;                                                         \
+#define NODE_ASSERT(cond, msg)                                         \
+    if (!(cond)) {                                                     \
+        NODE_LOG_ERROR("[" << __LINE__ << "] Assert: " << msg);        \
+        return 1;                                                      \
     }
 
-#define NODE_EXPECT(cond, msg)                                            \
-    if (!(cond)) {                                                        \
-        std::cout << "[" << __LINE__ << "] Assert: " << msg << std::endl; \
+#define NODE_EXPECT(cond, msg)                                         \
+    if (!(cond)) {                                                     \
+        NODE_LOG_WARNING("[" << __LINE__ << "] Assert: " << msg);      \
     }
 
 int get_int_parameter(const std::string& name, const struct CustomNodeParam* params, int paramsCount, int defaultValue = 0) {
@@ -127,6 +131,77 @@ std::vector<float> get_float_list_parameter(const std::string& name, const struc
     return result;
 }
 
+std::vector<int> get_int_list_parameter(const std::string& name, const struct CustomNodeParam* params, int paramsCount) {
+    std::string listStr;
+    for (int i = 0; i < paramsCount; i++) {
+        if (name == params[i].key) {
+            listStr = params[i].value;
+            break;
+        }
+    }
+
+    if (listStr.length() < 2 || listStr.front() != '[' || listStr.back() != ']') {
+        return {};
+    }
+
+    listStr = listStr.substr(1, listStr.size() - 2);
+
+    std::vector<int> result;
+
+    std::stringstream lineStream(listStr);
+    std::string element;
+    while (std::getline(lineStream, element, ',')) {
+        try {
+            int e = std::stoi(element.c_str());
+            result.push_back(e);
+        } catch (std::invalid_argument& e) {
+            NODE_EXPECT(false, "error parsing list parameter");
+            return {};
+        } catch (std::out_of_range& e) {
+            NODE_EXPECT(false, "error parsing list parameter");
+            return {};
+        }
+    }
+
+    return result;
+}
+
+// Reads logging parameters of single node into its settings, other nodes of the library keep their own:
+// log_level - TRACE, DEBUG, INFO, WARNING, ERROR or OFF, INFO by default or DEBUG when debug is true
+// log_rate_limit - maximal number of messages per second, 1000 by default, 0 for no limit
+int configure_logger(ovms::custom_nodes_common::LogSettings& settings, const struct CustomNodeParam* params, int paramsCount) {
+    using ovms::custom_nodes_common::LogLevel;
+    bool debugMode = get_string_parameter("debug", params, paramsCount) == "true";
+    LogLevel level = debugMode ? LogLevel::DEBUG : LogLevel::INFO;
+    std::string logLevel = get_string_parameter("log_level", params, paramsCount);
+    NODE_ASSERT(logLevel.empty() || ovms::custom_nodes_common::parse_log_level(logLevel, level), "log level must be TRACE, DEBUG, INFO, WARNING, ERROR or OFF");
+    int rateLimit = get_int_parameter("log_rate_limit", params, paramsCount, ovms::custom_nodes_common::DEFAULT_LOG_RATE_LIMIT);
+    NODE_ASSERT(rateLimit >= 0, "log rate limit must not be negative");
+    settings.setLevel(level);
+    settings.setRateLimit(rateLimit);
+    return 0;
+}
+
+// Reads parameters of thread pool shared by all nodes of the library, pool is created with configuration known at first parallel call:
+// thread_pool_size - number of threads used for parallel work, calling thread included, min(cpus, 4) by default
+// thread_pool_pinning - true to pin pool workers to separate cpus, false by default
+int configure_thread_pool(const struct CustomNodeParam* params, int paramsCount) {
+    int threads = get_int_parameter("thread_pool_size", params, paramsCount, ovms::custom_nodes_common::default_thread_count());
+    NODE_ASSERT(threads > 0, "thread pool size must be larger than 0");
+    std::string pinning = get_string_parameter("thread_pool_pinning", params, paramsCount, "false");
+    NODE_ASSERT(pinning == "true" || pinning == "false", "thread pool pinning must be true or false");
+    NODE_EXPECT(ovms::custom_nodes_common::ThreadPool::configure(threads, pinning == "true"), "thread pool is already running with different configuration");
+    return 0;
+}
+
+// Reports extension version of common code and given capability flags.
+int set_capabilities(struct CustomNodeCapabilities* capabilities, uint64_t flags) {
+    NODE_ASSERT(capabilities != nullptr, "capabilities are null");
+    capabilities->version = CUSTOM_NODE_EXTENSION_VERSION;
+    capabilities->flags = flags;
+    return 0;
+}
+
 std::string floatListToString(const std::vector<float>& values) {
     std::stringstream ss;
     ss << "[";
@@ -139,6 +214,43 @@ std::string floatListToString(const std::vector<float>& values) {
     return ss.str();
 }
 
+// IEEE 754 binary16 conversion with round to nearest even, as used for FP16 tensors
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    uint32_t absBits = bits & 0x7fffffff;
+    // infinity and NaN
+    if (absBits >= 0x7f800000) {
+        return sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0);
+    }
+    // rounds to infinity
+    if (absBits >= 0x477ff000) {
+        return sign | 0x7c00;
+    }
+    // subnormal or zero
+    if (absBits < 0x38800000) {
+        if (absBits < 0x33000000) {
+            return sign;
+        }
+        uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+        int shift = 126 - (int)(absBits >> 23);
+        uint32_t result = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (result & 1))) {
+            result++;
+        }
+        return sign | result;
+    }
+    uint32_t result = (absBits >> 13) - ((127 - 15) << 10);
+    uint32_t remainder = absBits & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1))) {
+        result++;
+    }
+    return sign | result;
+}
+
 void cleanup(CustomNodeTensor& tensor) {
     free(tensor.data);
     free(tensor.dims);
@@ -13,168 +13,675 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //*****************************************************************************
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <initializer_list>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <new>
+#include <shared_mutex>
 #include <string>
+#include <vector>
 
 #include "../../custom_node_interface.h"
+#include "../common/async_executor_utils.hpp"
+#include "../common/buffersqueue_utils.hpp"
+#include "../common/custom_node_library_internal_manager.hpp"
 #include "../common/opencv_utils.hpp"
+#include "../common/parallel.hpp"
+#include "../common/segmentation_kernels.hpp"
+#include "../common/tiling.hpp"
 #include "../common/utils.hpp"
 #include "opencv2/opencv.hpp"
 
+using CustomNodeLibraryInternalManager = ovms::custom_nodes_common::CustomNodeLibraryInternalManager;
+
 static constexpr const char* TENSOR_NAME = "image";
+// original image height and width, produced by deeplabv3_preprocessing
+static constexpr const char* ORIGINAL_SIZE_TENSOR_NAME = "original_size";
+static constexpr int ORIGINAL_SIZE_SIZE = 2;
+// position of each tile in original image, produced by deeplabv3_preprocessing in tiling mode
+static constexpr const char* TILE_INFO_TENSOR_NAME = "tile_info";
 
-int initialize(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+// run length encoded mask: (class, length) pairs in row major order and mask height and width
+static constexpr const char* MASK_RLE_TENSOR_NAME = "mask_rle";
+static constexpr const char* MASK_SIZE_TENSOR_NAME = "mask_size";
+
+static constexpr const char* OUTPUT_TENSOR_NAME = "output_tensor";
+static constexpr const char* OUTPUT_MASK_NAME = "output_mask";
+static constexpr const char* OUTPUT_MASK_DIMS_NAME = "output_mask_dims";
+static constexpr const char* OUTPUT_MASK_RLE_NAME = "output_mask_rle";
+static constexpr const char* OUTPUT_MASK_SIZE_NAME = "output_mask_size";
+
+// mask buffers are sized for this resolution when input_h and input_w are not specified,
+// larger masks are allocated on heap
+static constexpr int DEFAULT_MASK_HEIGHT = 513;
+static constexpr int DEFAULT_MASK_WIDTH = 513;
+// masks with more pixels are rejected, sizes come from client controlled inputs
+static constexpr int DEFAULT_MAX_MASK_AREA = 8192 * 8192;
+
+using ovms::custom_nodes_common::ScoresLayout;
+using ovms::custom_nodes_common::Tile;
+using ovms::custom_nodes_common::TILE_INFO_SIZE;
+
+enum class MaskResize {
+    NONE,      // mask in model output resolution
+    NEAREST,   // class map resized with nearest neighbour interpolation
+    BILINEAR   // argmax of bilinearly resized class scores
+};
+
+enum class MaskEncoding {
+    DENSE,
+    RLE
+};
+
+// Parameters parsed and validated once in initialize()
+struct DeepLabPostprocessingParameters {
+    int sourceImageHeight;
+    int sourceImageWidth;
+    int numClass;
+    // layout is matched against num_class for each input when not specified
+    bool isLayoutDefined;
+    ScoresLayout layout;
+    int argmaxThreads;
+    MaskResize maskResize;
+    MaskEncoding maskEncoding;
+    // upper bound of pixels of single mask, checked before mask memory is allocated
+    uint64_t maxMaskArea;
+    // images in batch above this size are still processed, but their buffers are not preallocated
+    int maxBatchSize;
+    int batchThreads;
+    // batch holds tiles of single image, their masks are stitched into mask of the image
+    bool tiling;
+    bool debugMode;
+};
+
+static int readParameters(const struct CustomNodeParam* params, int paramsCount, DeepLabPostprocessingParameters& parameters) {
+    parameters.sourceImageHeight = get_int_parameter("input_h", params, paramsCount, -1);
+    parameters.sourceImageWidth = get_int_parameter("input_w", params, paramsCount, -1);
+    NODE_ASSERT(parameters.sourceImageHeight > 0 || parameters.sourceImageHeight == -1, "Source image height - when specified, must be larger than 0");
+    NODE_ASSERT(parameters.sourceImageWidth > 0 || parameters.sourceImageWidth == -1, "Source image width - when specified, must be larger than 0");
+
+    std::string layout = get_string_parameter("input_layout", params, paramsCount, "");
+    NODE_ASSERT(layout == "" || layout == "NCHW" || layout == "NHWC", "input layout - when specified, must be NCHW or NHWC");
+    parameters.isLayoutDefined = layout != "";
+    parameters.layout = layout == "NHWC" ? ScoresLayout::NHWC : ScoresLayout::NCHW;
+
+    // With input layout specified number of class may be derived from input tensor
+    parameters.numClass = get_int_parameter("num_class", params, paramsCount, -1);
+    NODE_ASSERT(parameters.numClass > 0 || (parameters.numClass == -1 && parameters.isLayoutDefined), "Number of class - must be larger than 0, can be omitted only with input layout specified");
+    NODE_ASSERT(parameters.numClass <= ovms::custom_nodes_common::MAX_ARGMAX_CLASSES, "Number of class - must not exceed 256");
+
+    // Large masks are split into row bands computed in parallel, by default using up to 4 threads.
+    parameters.argmaxThreads = get_int_parameter("argmax_threads", params, paramsCount, ovms::custom_nodes_common::default_thread_count());
+    NODE_ASSERT(parameters.argmaxThreads > 0, "argmax threads - must be larger than 0");
+
+    // Mask may be resized to original image size given by original_size input.
+    std::string maskResize = get_string_parameter("mask_resize", params, paramsCount, "none");
+    NODE_ASSERT(maskResize == "none" || maskResize == "nearest" || maskResize == "bilinear", "mask resize - must be none, nearest or bilinear");
+    parameters.maskResize = maskResize == "nearest" ? MaskResize::NEAREST : maskResize == "bilinear" ? MaskResize::BILINEAR : MaskResize::NONE;
+
+    std::string maskEncoding = get_string_parameter("mask_encoding", params, paramsCount, "dense");
+    NODE_ASSERT(maskEncoding == "dense" || maskEncoding == "rle", "mask encoding - must be dense or rle");
+    parameters.maskEncoding = maskEncoding == "rle" ? MaskEncoding::RLE : MaskEncoding::DENSE;
+    // Mask sizes come from inputs, masks larger than this are rejected.
+    int maxMaskArea = get_int_parameter("max_mask_area", params, paramsCount, DEFAULT_MAX_MASK_AREA);
+    NODE_ASSERT(maxMaskArea > 0, "max mask area - must be larger than 0");
+    parameters.maxMaskArea = maxMaskArea;
+
+    parameters.maxBatchSize = get_int_parameter("max_batch_size", params, paramsCount, 1);
+    NODE_ASSERT(parameters.maxBatchSize > 0, "max batch size must be larger than 0");
+    parameters.batchThreads = get_int_parameter("batch_threads", params, paramsCount, ovms::custom_nodes_common::default_thread_count());
+    NODE_ASSERT(parameters.batchThreads > 0, "batch threads must be larger than 0");
+    parameters.tiling = get_string_parameter("tiling", params, paramsCount, "false") == "true";
+
+    // Debug flag for additional logging.
+    parameters.debugMode = get_string_parameter("debug", params, paramsCount) == "true";
+    return 0;
+}
+
+static int initializeBuffersQueues(CustomNodeLibraryInternalManager* internalManager, const DeepLabPostprocessingParameters& parameters, const struct CustomNodeParam* params, int paramsCount) {
+    // reading parameters to determine BuffersQueues sizes
+    int queueSize = get_int_parameter("buffer_queue_size", params, paramsCount, 24);
+    NODE_ASSERT(queueSize > 0, "buffer queue size must be larger than 0");
+    auto buffersQueueOptions = get_buffers_queue_options(params, paramsCount, queueSize);
+    // huge pages and NUMA binding are meant for large data buffers, small metadata pools keep default options
+    const ovms::custom_nodes_common::BuffersQueueOptions metadataBuffersQueueOptions{};
+
+    // creating BuffersQueues for output: class mask
+    int maskHeight = get_int_parameter("input_h", params, paramsCount, DEFAULT_MASK_HEIGHT);
+    int maskWidth = get_int_parameter("input_w", params, paramsCount, DEFAULT_MASK_WIDTH);
+    NODE_ASSERT(maskHeight > 0 && maskWidth > 0, "mask dimensions must be larger than 0");
+    // in tiling mode max_batch_size is number of tiles, their total size covers stitched mask
+    uint64_t maskByteSize = sizeof(uint8_t) * parameters.maxBatchSize * maskHeight * maskWidth;
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_MASK_NAME, maskByteSize, queueSize, buffersQueueOptions), "output mask buffer creation failed");
+    // run length encoding buffers fit mask with average run of 8 pixels, longer encodings are allocated on heap
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_MASK_RLE_NAME, maskByteSize, queueSize, buffersQueueOptions), "output mask rle buffer creation failed");
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_MASK_SIZE_NAME, parameters.maxBatchSize * ORIGINAL_SIZE_SIZE * sizeof(int32_t), queueSize, metadataBuffersQueueOptions), "output mask size buffer creation failed");
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_MASK_DIMS_NAME, 3 * sizeof(uint64_t), queueSize * 2, metadataBuffersQueueOptions), "output mask dims buffer creation failed");
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_TENSOR_NAME, 2 * sizeof(CustomNodeTensor), queueSize, metadataBuffersQueueOptions), "output tensor buffer creation failed");
+    return 0;
+}
+
+static int initializeParametersAndBuffersQueues(CustomNodeLibraryInternalManager* internalManager, const struct CustomNodeParam* params, int paramsCount) {
+    // parameters are parsed once here, execute() only reads them
+    // messages of initialization are filtered by settings of initialized node
+    ovms::custom_nodes_common::LogSettings::Scope logScope(internalManager->getLogSettings());
+    NODE_ASSERT(configure_logger(internalManager->getLogSettings(), params, paramsCount) == 0, "logger configuration failed");
+    NODE_ASSERT(configure_thread_pool(params, paramsCount) == 0, "thread pool configuration failed");
+    std::unique_ptr<DeepLabPostprocessingParameters> parameters = std::make_unique<DeepLabPostprocessingParameters>();
+    NODE_ASSERT(readParameters(params, paramsCount, *parameters) == 0, "node parameters are invalid");
+    NODE_ASSERT(initializeBuffersQueues(internalManager, *parameters, params, paramsCount) == 0, "buffers queues creation failed");
+    internalManager->setParameters(std::move(parameters));
     return 0;
 }
 
+static int initializeInternalManager(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    // creating InternalManager instance
+    std::unique_ptr<CustomNodeLibraryInternalManager> internalManager = std::make_unique<CustomNodeLibraryInternalManager>();
+    NODE_ASSERT(internalManager != nullptr, "internalManager allocation failed");
+    NODE_ASSERT(initializeParametersAndBuffersQueues(internalManager.get(), params, paramsCount) == 0, "internalManager initialization failed");
+    create_async_executor(internalManager.get(), params, paramsCount);
+    *customNodeLibraryInternalManager = internalManager.release();
+    return 0;
+}
+
+static int reinitializeInternalManagerIfNecessary(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(*customNodeLibraryInternalManager);
+    // executions are blocked while parameters and queues are replaced, buffers still in flight are returned to replaced queues
+    std::unique_lock<std::shared_timed_mutex> lock(internalManager->getInternalManagerLock());
+    NODE_ASSERT(initializeParametersAndBuffersQueues(internalManager, params, paramsCount) == 0, "internalManager reinitialization failed");
+    return 0;
+}
+
+int initialize(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    if (*customNodeLibraryInternalManager == nullptr) {
+        return initializeInternalManager(customNodeLibraryInternalManager, params, paramsCount);
+    }
+    return reinitializeInternalManagerIfNecessary(customNodeLibraryInternalManager, params, paramsCount);
+}
+
 int deinitialize(void* customNodeLibraryInternalManager) {
+    // deallocate InternalManager and its contents
+    if (customNodeLibraryInternalManager != nullptr) {
+        CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+        delete internalManager;
+    }
     return 0;
 }
 
-int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
-    // Parameters reading
-    int _sourceImageHeight = get_int_parameter("input_h", params, paramsCount, -1);
-    int _sourceImageWidth = get_int_parameter("input_w", params, paramsCount, -1);
-    NODE_ASSERT(_sourceImageHeight > 0 || _sourceImageHeight == -1, "Source image height - when specified, must be larger than 0");
-    NODE_ASSERT(_sourceImageWidth > 0 || _sourceImageHeight == -1, "Source image width - when specified, must be larger than 0");
+static void setOutput(CustomNodeTensor& output, const char* name, void* data, uint64_t dataBytes, uint64_t* dims, std::initializer_list<uint64_t> shape, CustomNodeTensorPrecision precision) {
+    output.name = name;
+    output.data = reinterpret_cast<uint8_t*>(data);
+    output.dataBytes = dataBytes;
+    output.dims = dims;
+    output.dimsCount = shape.size();
+    std::copy(shape.begin(), shape.end(), dims);
+    output.precision = precision;
+}
+
+// Takes ownership of masks buffer. Single image mask has [height, width] shape, batch of masks [batch, height, width].
+static int writeDenseOutput(CustomNodeLibraryInternalManager* internalManager, uint8_t* masks, bool isBatched, uint64_t batchSize, uint64_t height, uint64_t width, struct CustomNodeTensor** outputs, int* outputsCount) {
+    uint64_t* dims = nullptr;
+    if (!get_buffer<uint64_t>(internalManager, &dims, OUTPUT_MASK_DIMS_NAME, 3 * sizeof(uint64_t)) ||
+        !get_buffer<struct CustomNodeTensor>(internalManager, outputs, OUTPUT_TENSOR_NAME, 1 * sizeof(CustomNodeTensor))) {
+        release(masks, internalManager);
+        if (dims != nullptr) {
+            release(dims, internalManager);
+        }
+        NODE_ASSERT(false, "buffer acquire failed");
+    }
+    *outputsCount = 1;
+    if (isBatched) {
+        setOutput((*outputs)[0], TENSOR_NAME, masks, batchSize * height * width, dims, {batchSize, height, width}, U8);
+    } else {
+        setOutput((*outputs)[0], TENSOR_NAME, masks, height * width, dims, {height, width}, U8);
+    }
+    return 0;
+}
+
+// Runs of all masks are concatenated in batch order, runs never cross masks boundaries, so they are split by mask sizes.
+static int writeRleOutputs(CustomNodeLibraryInternalManager* internalManager, const std::vector<const uint8_t*>& masks, const std::vector<int32_t>& maskSizes, struct CustomNodeTensor** outputs, int* outputsCount) {
+    const uint64_t batchSize = masks.size();
+    std::vector<uint64_t> maskRuns(batchSize);
+    uint64_t runs = 0;
+    for (uint64_t b = 0; b < batchSize; b++) {
+        maskRuns[b] = ovms::custom_nodes_common::count_runs(masks[b], (uint64_t)maskSizes[b * ORIGINAL_SIZE_SIZE] * maskSizes[b * ORIGINAL_SIZE_SIZE + 1]);
+        runs += maskRuns[b];
+    }
+    int32_t* rle = nullptr;
+    int32_t* maskSize = nullptr;
+    uint64_t* dims[2] = {nullptr, nullptr};
+    bool acquired = get_buffer<int32_t>(internalManager, &rle, OUTPUT_MASK_RLE_NAME, runs * 2 * sizeof(int32_t)) &&
+                    get_buffer<int32_t>(internalManager, &maskSize, OUTPUT_MASK_SIZE_NAME, batchSize * ORIGINAL_SIZE_SIZE * sizeof(int32_t)) &&
+                    get_buffer<uint64_t>(internalManager, &dims[0], OUTPUT_MASK_DIMS_NAME, 3 * sizeof(uint64_t)) &&
+                    get_buffer<uint64_t>(internalManager, &dims[1], OUTPUT_MASK_DIMS_NAME, 3 * sizeof(uint64_t)) &&
+                    get_buffer<struct CustomNodeTensor>(internalManager, outputs, OUTPUT_TENSOR_NAME, 2 * sizeof(CustomNodeTensor));
+    if (!acquired) {
+        void* buffers[] = {rle, maskSize, dims[0], dims[1]};
+        for (void* buffer : buffers) {
+            if (buffer != nullptr) {
+                release(buffer, internalManager);
+            }
+        }
+        NODE_ASSERT(false, "buffer acquire failed");
+    }
+    int32_t* position = rle;
+    for (uint64_t b = 0; b < batchSize; b++) {
+        ovms::custom_nodes_common::encode_runs(masks[b], (uint64_t)maskSizes[b * ORIGINAL_SIZE_SIZE] * maskSizes[b * ORIGINAL_SIZE_SIZE + 1], position);
+        position += 2 * maskRuns[b];
+    }
+    std::copy(maskSizes.begin(), maskSizes.begin() + batchSize * ORIGINAL_SIZE_SIZE, maskSize);
+
+    *outputsCount = 2;
+    setOutput((*outputs)[0], MASK_RLE_TENSOR_NAME, rle, runs * 2 * sizeof(int32_t), dims[0], {runs, 2}, I32);
+    setOutput((*outputs)[1], MASK_SIZE_TENSOR_NAME, maskSize, batchSize * ORIGINAL_SIZE_SIZE * sizeof(int32_t), dims[1], {batchSize, (uint64_t)ORIGINAL_SIZE_SIZE}, I32);
+    return 0;
+}
+
+// Computes class mask of single image, resized to mask height and width when resizing is enabled.
+static int computeMask(const float* scores, ScoresLayout layout, int height, int width, int channels, uint8_t* mask, int maskHeight, int maskWidth,
+    MaskResize maskResize, int threads) {
+    switch (maskResize) {
+    case MaskResize::NONE:
+        ovms::custom_nodes_common::argmax_mask(scores, layout, height, width, channels, mask, threads);
+        break;
+    case MaskResize::NEAREST: {
+        // scratch buffer reused by executions on the same thread
+        static thread_local std::vector<uint8_t> sourceMask;
+        sourceMask.resize((size_t)height * width);
+        ovms::custom_nodes_common::argmax_mask(scores, layout, height, width, channels, sourceMask.data(), threads);
+        try {
+            cv::Mat resizedMask(maskHeight, maskWidth, CV_8UC1, mask);
+            cv::resize(cv::Mat(height, width, CV_8UC1, sourceMask.data()), resizedMask, resizedMask.size(), 0, 0, cv::INTER_NEAREST);
+        } catch (const cv::Exception& e) {
+            NODE_LOG_ERROR(e.what());
+            return 1;
+        }
+        break;
+    }
+    case MaskResize::BILINEAR:
+        ovms::custom_nodes_common::argmax_resized_bilinear(scores, layout, height, width, channels, mask, maskHeight, maskWidth, threads);
+        break;
+    }
+    return 0;
+}
+
+// Computes class mask of single tile and copies part of the image owned by the tile into mask of rows x cols image.
+// Scores in resolution other than tile size are resized to it, nearest neighbour is used when resizing is disabled.
+static int stitchTileMask(const float* scores, ScoresLayout layout, int height, int width, int channels, const Tile& tile, const Tile& region,
+    uint8_t* mask, int cols, MaskResize maskResize, int threads) {
+    // scratch buffer reused by tiles computed on the same thread
+    static thread_local std::vector<uint8_t> tileMask;
+    // runs on pool threads, exception must not leave them
+    try {
+        tileMask.resize((size_t)tile.height * tile.width);
+    } catch (const std::bad_alloc&) {
+        NODE_LOG_ERROR("tile mask of " << tile.height << "x" << tile.width << " could not be allocated");
+        return 1;
+    }
+    if (height == tile.height && width == tile.width) {
+        maskResize = MaskResize::NONE;
+    } else if (maskResize == MaskResize::NONE) {
+        maskResize = MaskResize::NEAREST;
+    }
+    NODE_ASSERT(computeMask(scores, layout, height, width, channels, tileMask.data(), tile.height, tile.width, maskResize, threads) == 0, "tile mask computation failed");
+    for (int y = region.y; y < region.y + region.height; y++) {
+        const uint8_t* source = tileMask.data() + (size_t)(y - tile.y) * tile.width + (region.x - tile.x);
+        std::copy(source, source + region.width, mask + (size_t)y * cols + region.x);
+    }
+    return 0;
+}
+
+// Masks of all tiles of batch are stitched into single mask of the image described by tile info.
+static int executeTiled(CustomNodeLibraryInternalManager* internalManager, const DeepLabPostprocessingParameters& parameters, const CustomNodeTensor* tileInfoTensor,
+    const float* scores, ScoresLayout layout, uint64_t batchSize, uint64_t height, uint64_t width, uint64_t channels, struct CustomNodeTensor** outputs, int* outputsCount) {
+    NODE_ASSERT(tileInfoTensor->precision == I32, "tile info tensor precision must be I32");
+    NODE_ASSERT(tileInfoTensor->dataBytes == batchSize * TILE_INFO_SIZE * sizeof(int32_t), "tile info tensor must have 6 values for each tile");
+    std::vector<Tile> tiles;
+    int rows = 0;
+    int cols = 0;
+    NODE_ASSERT(ovms::custom_nodes_common::read_tile_info(reinterpret_cast<const int32_t*>(tileInfoTensor->data), batchSize, tiles, rows, cols), "tile info must describe tiles covering image");
+    // tile and image sizes come from input, both are bounded before tile and stitched masks are allocated
+    NODE_ASSERT((uint64_t)tiles[0].height * tiles[0].width <= parameters.maxMaskArea, "tile size must not exceed max_mask_area pixels");
+    NODE_ASSERT((uint64_t)rows * cols <= parameters.maxMaskArea, "tiled image size must not exceed max_mask_area pixels");
+    const std::vector<Tile> regions = ovms::custom_nodes_common::owned_regions(tiles, rows, cols);
+
+    // Dense mask is stitched directly in output buffer, mask to be encoded in scratch buffer reused by thread.
+    static thread_local std::vector<uint8_t> encodedMask;
+    uint8_t* mask = nullptr;
+    if (parameters.maskEncoding == MaskEncoding::DENSE) {
+        NODE_ASSERT(get_buffer<uint8_t>(internalManager, &mask, OUTPUT_MASK_NAME, (uint64_t)rows * cols), "buffer acquire failed");
+    } else {
+        try {
+            encodedMask.resize((size_t)rows * cols);
+        } catch (const std::bad_alloc&) {
+            NODE_LOG_ERROR("mask of " << rows << "x" << cols << " could not be allocated");
+            return 1;
+        }
+        mask = encodedMask.data();
+    }
+
+    // Owned regions do not overlap, so tiles are written in parallel.
+    const size_t imageSize = channels * height * width;
+    const int tileThreads = std::max<int>(1, parameters.argmaxThreads / (int)std::min<uint64_t>(batchSize, parameters.batchThreads));
+    std::atomic<int> failures{0};
+    ovms::custom_nodes_common::parallel_for(batchSize, parameters.batchThreads, [&](size_t t) {
+        if (stitchTileMask(scores + t * imageSize, layout, (int)height, (int)width, (int)channels, tiles[t], regions[t], mask, cols, parameters.maskResize, tileThreads) != 0) {
+            failures++;
+        }
+    });
+    if (failures > 0) {
+        if (parameters.maskEncoding == MaskEncoding::DENSE) {
+            release(mask, internalManager);
+        }
+        return 1;
+    }
 
-    int _numClass = get_int_parameter("num_class", params, paramsCount, -1);
-    NODE_ASSERT(_numClass > 0, "Number of class - must be larger than 0");
+    if (parameters.maskEncoding == MaskEncoding::DENSE) {
+        NODE_ASSERT(writeDenseOutput(internalManager, mask, false, 1, rows, cols, outputs, outputsCount) == 0, "output creation failed");
+    } else {
+        NODE_ASSERT(writeRleOutputs(internalManager, {mask}, {rows, cols}, outputs, outputsCount) == 0, "output creation failed");
+    }
+    return 0;
+}
+
+int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+    NODE_ASSERT(internalManager != nullptr, "internalManager is not initialized");
+    std::shared_lock<std::shared_timed_mutex> lock(internalManager->getInternalManagerLock());
+    ovms::custom_nodes_common::LogSettings::Scope logScope(internalManager->getLogSettings());
 
-    // // Debug flag for additional logging.
-    bool debugMode = get_string_parameter("debug", params, paramsCount) == "true";
+    // Parameters are parsed and validated in initialize()
+    const DeepLabPostprocessingParameters* parameters = internalManager->getParameters<DeepLabPostprocessingParameters>();
+    NODE_ASSERT(parameters != nullptr, "node parameters are not initialized");
+    const int _sourceImageHeight = parameters->sourceImageHeight;
+    const int _sourceImageWidth = parameters->sourceImageWidth;
+    const int _numClass = parameters->numClass;
+    const bool debugMode = parameters->debugMode;
 
     // // ------------ validation start -------------
-    NODE_ASSERT(inputsCount == 1, "there must be exactly one input");
-    const CustomNodeTensor* imageTensor = inputs;
+    // original_size is used only with mask resizing, tile_info replaces it in tiling mode
+    const CustomNodeTensor* imageTensor = nullptr;
+    const CustomNodeTensor* originalSizeTensor = nullptr;
+    const CustomNodeTensor* tileInfoTensor = nullptr;
+    for (int i = 0; i < inputsCount; i++) {
+        if (std::strcmp(inputs[i].name, TENSOR_NAME) == 0) {
+            imageTensor = &(inputs[i]);
+        } else if (!parameters->tiling && std::strcmp(inputs[i].name, ORIGINAL_SIZE_TENSOR_NAME) == 0) {
+            originalSizeTensor = &(inputs[i]);
+        } else if (parameters->tiling && std::strcmp(inputs[i].name, TILE_INFO_TENSOR_NAME) == 0) {
+            tileInfoTensor = &(inputs[i]);
+        } else {
+            NODE_LOG_ERROR("Unrecognized input: " << inputs[i].name);
+            return 1;
+        }
+    }
+    NODE_ASSERT(imageTensor != nullptr, "Missing input image");
+    NODE_ASSERT(!parameters->tiling || tileInfoTensor != nullptr, "Missing input tile_info required by tiling");
     
     if(debugMode){
-        std::cout << "Validation Start, Input Data Checking" << std::endl;
-        std::cout << "inputsCount : " << inputsCount << std::endl;
-        std::cout << "Tensor name : " << imageTensor->name << ";" << TENSOR_NAME << std::endl;
-        std::cout << "dims count : " << imageTensor->dimsCount << std::endl;
+        NODE_LOG_DEBUG("Validation Start, Input Data Checking");
+        NODE_LOG_DEBUG("inputsCount : " << inputsCount);
+        NODE_LOG_DEBUG("Tensor name : " << imageTensor->name << ";" << TENSOR_NAME);
+        NODE_LOG_DEBUG("dims count : " << imageTensor->dimsCount);
     }
     
-    NODE_ASSERT(std::strcmp(imageTensor->name, TENSOR_NAME) == 0, "node input name is wrong");
     NODE_ASSERT(imageTensor->dimsCount == 4, "image tensor shape must have 4 dimensions")
-    NODE_ASSERT(imageTensor->dims[0] == 1, "image tensor must have batch size equal to 1")
+    const uint64_t batchSize = imageTensor->dims[0];
+    NODE_ASSERT(batchSize > 0, "image tensor batch size must be positive");
+    NODE_ASSERT(imageTensor->precision == FP32, "image tensor precision must be FP32");
 
+    // Layout is taken from parameters or recognized by position of class dimension.
+    // Input with both dimensions equal to number of class is treated as NCHW.
+    ScoresLayout layout = parameters->layout;
+    if (!parameters->isLayoutDefined) {
+        NODE_ASSERT(imageTensor->dims[1] == (uint64_t)_numClass || imageTensor->dims[3] == (uint64_t)_numClass, "image tensor must have number of class in second (NCHW) or last (NHWC) dimension");
+        layout = imageTensor->dims[1] == (uint64_t)_numClass ? ScoresLayout::NCHW : ScoresLayout::NHWC;
+    }
+    const bool isNchw = layout == ScoresLayout::NCHW;
+    const uint64_t channels = isNchw ? imageTensor->dims[1] : imageTensor->dims[3];
+    const uint64_t height = isNchw ? imageTensor->dims[2] : imageTensor->dims[1];
+    const uint64_t width = isNchw ? imageTensor->dims[3] : imageTensor->dims[2];
+    NODE_ASSERT(_numClass == -1 || channels == (uint64_t)_numClass, "image tensor number of class does not match num_class parameter");
+    NODE_ASSERT(channels > 0 && channels <= ovms::custom_nodes_common::MAX_ARGMAX_CLASSES, "image tensor number of class must be between 1 and 256");
+    NODE_ASSERT(height > 0 && width > 0 && height <= INT32_MAX && width <= INT32_MAX, "image tensor height and width must be positive");
+    NODE_ASSERT(imageTensor->dataBytes == batchSize * channels * height * width * sizeof(float), "image tensor data size does not match its shape");
+
+    if (parameters->tiling) {
+        NODE_ASSERT(executeTiled(internalManager, *parameters, tileInfoTensor, (const float*)imageTensor->data, layout, batchSize, height, width, channels, outputs, outputsCount) == 0, "tiled mask creation failed");
+        if (debugMode) {
+            internalManager->logStatistics();
+        }
+        return 0;
+    }
+
+    // Height and width of each mask, original size holds one row per image or single row shared by all images of batch.
+    static thread_local std::vector<int32_t> maskSizes;
+    maskSizes.resize(batchSize * ORIGINAL_SIZE_SIZE);
+    for (uint64_t b = 0; b < batchSize; b++) {
+        maskSizes[b * ORIGINAL_SIZE_SIZE] = height;
+        maskSizes[b * ORIGINAL_SIZE_SIZE + 1] = width;
+    }
+    if (parameters->maskResize != MaskResize::NONE) {
+        NODE_ASSERT(originalSizeTensor != nullptr, "Missing input original_size required by mask resize");
+        NODE_ASSERT(originalSizeTensor->precision == I32, "original size tensor precision must be I32");
+        NODE_ASSERT(originalSizeTensor->dataBytes == ORIGINAL_SIZE_SIZE * sizeof(int32_t) || originalSizeTensor->dataBytes == batchSize * ORIGINAL_SIZE_SIZE * sizeof(int32_t),
+            "original size tensor must contain height and width for each image or height and width shared by all images");
+        const int32_t* originalSize = reinterpret_cast<const int32_t*>(originalSizeTensor->data);
+        const size_t originalSizeStride = originalSizeTensor->dataBytes == ORIGINAL_SIZE_SIZE * sizeof(int32_t) ? 0 : ORIGINAL_SIZE_SIZE;
+        for (uint64_t b = 0; b < batchSize; b++) {
+            const int32_t* imageOriginalSize = originalSize + b * originalSizeStride;
+            NODE_ASSERT(imageOriginalSize[0] > 0 && imageOriginalSize[1] > 0, "original size must be positive");
+            NODE_ASSERT((uint64_t)imageOriginalSize[0] * imageOriginalSize[1] <= parameters->maxMaskArea, "original size must not exceed max_mask_area pixels");
+            maskSizes[b * ORIGINAL_SIZE_SIZE] = imageOriginalSize[0];
+            maskSizes[b * ORIGINAL_SIZE_SIZE + 1] = imageOriginalSize[1];
+        }
+    }
+    // dense masks of batch share single tensor
+    const uint64_t maskHeight = maskSizes[0];
+    const uint64_t maskWidth = maskSizes[1];
+    if (parameters->maskEncoding == MaskEncoding::DENSE) {
+        for (uint64_t b = 1; b < batchSize; b++) {
+            NODE_ASSERT(maskSizes[b * ORIGINAL_SIZE_SIZE] == (int32_t)maskHeight && maskSizes[b * ORIGINAL_SIZE_SIZE + 1] == (int32_t)maskWidth, "dense masks of batch must have the same size");
+        }
+    }
 
     if (debugMode) {
-        std::cout << "source image height : " << _sourceImageHeight    << std::endl;
-        std::cout << "source image height : " << _sourceImageWidth     << std::endl;
-        std::cout << "number of class : "     << _numClass             << std::endl;
-        std::cout << "input shape[0] "      << imageTensor->dims[0] << std::endl;
-        std::cout << "input shape[1] "      << imageTensor->dims[1] << std::endl;
-        std::cout << "input shape[2] "      << imageTensor->dims[2] << std::endl;
-        std::cout << "input shape[3]"      << imageTensor->dims[3] << std::endl;
+        NODE_LOG_DEBUG("source image height : " << _sourceImageHeight);
+        NODE_LOG_DEBUG("source image width : " << _sourceImageWidth);
+        NODE_LOG_DEBUG("number of class : " << channels);
+        NODE_LOG_DEBUG("input layout : " << (isNchw ? "NCHW" : "NHWC"));
+        NODE_LOG_DEBUG("mask size : " << maskHeight << "x" << maskWidth);
+        NODE_LOG_DEBUG("input shape[0] " << imageTensor->dims[0]);
+        NODE_LOG_DEBUG("input shape[1] " << imageTensor->dims[1]);
+        NODE_LOG_DEBUG("input shape[2] " << imageTensor->dims[2]);
+        NODE_LOG_DEBUG("input shape[3] " << imageTensor->dims[3]);
     }
     // // ------------- validation end ---------------
 
     const float* output_buffer = (float*)imageTensor->data;
+    const size_t imageSize = channels * height * width;
 
-    const int height = 513;
-    const int width = 513;
-
-    // std::vector<uint8_t> argmax_result(height * width);
-    uint64_t byteSize = sizeof(uint8_t) * height * width;
-    // std::cout << "argmax_result size : " << argmax_result.size() << std::endl;
-    // std::cout << "calcaulat bytesize : " << byteSize << std::endl;
-
-    uint8_t* buffer = (uint8_t*)malloc(byteSize);
-    NODE_ASSERT(buffer != nullptr, "malloc has failed.");
-
-    for(int h = 0; h < height; ++h){
-        for(int w =0; w < width; ++w){
-            int index = h * width + w;
-            float max_val = output_buffer[index];
-            int max_index = 0;
-
-            for (int c=1; c< _numClass; ++c) {
-                float val = output_buffer[c * height * width + index];
-                if (val > max_val){
-                    max_val = val;
-                    max_index = c;
-                }
-            }
-
-            // argmax_result[index] = max_index*100; // for debug
-            // argmax_result[index] = max_index;
-            buffer[index] = max_index;
+    // Dense masks are computed directly in output buffer, masks to be encoded in scratch buffer reused by thread.
+    static thread_local std::vector<uint8_t> encodedMasks;
+    static thread_local std::vector<const uint8_t*> masks;
+    masks.resize(batchSize);
+    uint8_t* denseMasks = nullptr;
+    if (parameters->maskEncoding == MaskEncoding::DENSE) {
+        NODE_ASSERT(get_buffer<uint8_t>(internalManager, &denseMasks, OUTPUT_MASK_NAME, batchSize * maskHeight * maskWidth), "buffer acquire failed");
+        for (uint64_t b = 0; b < batchSize; b++) {
+            masks[b] = denseMasks + b * maskHeight * maskWidth;
+        }
+    } else {
+        size_t encodedBytes = 0;
+        for (uint64_t b = 0; b < batchSize; b++) {
+            encodedBytes += (size_t)maskSizes[b * ORIGINAL_SIZE_SIZE] * maskSizes[b * ORIGINAL_SIZE_SIZE + 1];
+        }
+        // each mask is bounded by max_mask_area, large batch may still exceed available memory
+        try {
+            encodedMasks.resize(encodedBytes);
+        } catch (const std::bad_alloc&) {
+            NODE_LOG_ERROR("masks of " << encodedBytes << " bytes could not be allocated");
+            return 1;
+        }
+        for (uint64_t b = 0, offset = 0; b < batchSize; b++) {
+            masks[b] = encodedMasks.data() + offset;
+            offset += (size_t)maskSizes[b * ORIGINAL_SIZE_SIZE] * maskSizes[b * ORIGINAL_SIZE_SIZE + 1];
         }
     }
 
-    *outputsCount = 1;
-    *outputs = (struct CustomNodeTensor*)malloc(*outputsCount * sizeof(CustomNodeTensor));
-
-    if ((*outputs) == nullptr) {
-        std::cout << "malloc has failed" << std::endl;
-        free(buffer);
+    // Images of batch are processed in parallel, argmax threads are shared between them.
+    // Workers access masks through references, thread_local names would resolve to their own instances.
+    const std::vector<const uint8_t*>& batchMasks = masks;
+    const std::vector<int32_t>& batchMaskSizes = maskSizes;
+    const int imageThreads = std::max<int>(1, parameters->argmaxThreads / (int)std::min<uint64_t>(batchSize, parameters->batchThreads));
+    std::atomic<int> failures{0};
+    ovms::custom_nodes_common::parallel_for(batchSize, parameters->batchThreads, [&](size_t b) {
+        if (computeMask(output_buffer + b * imageSize, layout, (int)height, (int)width, (int)channels, const_cast<uint8_t*>(batchMasks[b]),
+                batchMaskSizes[b * ORIGINAL_SIZE_SIZE], batchMaskSizes[b * ORIGINAL_SIZE_SIZE + 1], parameters->maskResize, imageThreads) != 0) {
+            failures++;
+        }
+    });
+    if (failures > 0) {
+        if (denseMasks != nullptr) {
+            release(denseMasks, internalManager);
+        }
         return 1;
     }
 
-    CustomNodeTensor& output = (*outputs)[0];
-    output.name = TENSOR_NAME;
-    output.data = reinterpret_cast<uint8_t*>(buffer);
-    output.dataBytes = byteSize;
-    output.dimsCount = 2;
-    output.dims = (uint64_t*)malloc(output.dimsCount * sizeof(uint64_t));
-    NODE_ASSERT(output.dims != nullptr, "malloc has failed");
-    output.dims[0] = 513;
-    output.dims[1] = 513;
-    output.precision = U8;
+    if (parameters->maskEncoding == MaskEncoding::DENSE) {
+        NODE_ASSERT(writeDenseOutput(internalManager, denseMasks, parameters->maxBatchSize > 1, batchSize, maskHeight, maskWidth, outputs, outputsCount) == 0, "output creation failed");
+    } else {
+        NODE_ASSERT(writeRleOutputs(internalManager, masks, maskSizes, outputs, outputsCount) == 0, "output creation failed");
+    }
 
+    if (debugMode) {
+        internalManager->logStatistics();
+    }
     return 0;
 }
 
+int executeAsync(const struct CustomNodeTensor* inputs, int inputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager,
+    CustomNodeCompletionCallback callback, void* userContext) {
+    return execute_async(execute, inputs, inputsCount, params, paramsCount, customNodeLibraryInternalManager, callback, userContext);
+}
+
+int getCapabilities(struct CustomNodeCapabilities* capabilities, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    return set_capabilities(capabilities, CUSTOM_NODE_CAPABILITY_EXECUTE_ASYNC);
+}
+
 int getInputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
-    std::cout<< "GetInputInfo Test" << std::endl;
-    *infoCount = 1;
+    DeepLabPostprocessingParameters parameters;
+    NODE_ASSERT(readParameters(params, paramsCount, parameters) == 0, "node parameters are invalid");
+
+    *infoCount = parameters.tiling || parameters.maskResize != MaskResize::NONE ? 2 : 1;
     *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
     NODE_ASSERT((*info) != nullptr, "malloc has failed");
-    
+
+    // unknown dimensions are reported as 0
+    uint64_t channels = parameters.numClass > 0 ? parameters.numClass : 0;
+    uint64_t height = parameters.sourceImageHeight > 0 ? parameters.sourceImageHeight : 0;
+    uint64_t width = parameters.sourceImageWidth > 0 ? parameters.sourceImageWidth : 0;
     (*info)[0].name = TENSOR_NAME;
     (*info)[0].dimsCount = 4;
     (*info)[0].dims = (uint64_t*)malloc((*info)->dimsCount * sizeof(uint64_t));
     NODE_ASSERT(((*info)[0].dims) != nullptr, "malloc has failed");
-    (*info)[0].dims[0] = 1;
-    (*info)[0].dims[1] = 3;
-    (*info)[0].dims[2] = 513;
-    (*info)[0].dims[3] = 513;
+    // number of tiles depends on image size
+    (*info)[0].dims[0] = parameters.maxBatchSize == 1 && !parameters.tiling ? 1 : 0;
+    if (!parameters.isLayoutDefined) {
+        // class dimension position is known only at execution
+        (*info)[0].dims[1] = 0;
+        (*info)[0].dims[2] = 0;
+        (*info)[0].dims[3] = 0;
+    } else if (parameters.layout == ScoresLayout::NCHW) {
+        (*info)[0].dims[1] = channels;
+        (*info)[0].dims[2] = height;
+        (*info)[0].dims[3] = width;
+    } else {
+        (*info)[0].dims[1] = height;
+        (*info)[0].dims[2] = width;
+        (*info)[0].dims[3] = channels;
+    }
     (*info)[0].precision = FP32;
+
+    if (parameters.tiling) {
+        // one row per tile
+        (*info)[1].name = TILE_INFO_TENSOR_NAME;
+        (*info)[1].dimsCount = 2;
+        (*info)[1].dims = (uint64_t*)malloc((*info)[1].dimsCount * sizeof(uint64_t));
+        NODE_ASSERT(((*info)[1].dims) != nullptr, "malloc has failed");
+        (*info)[1].dims[0] = 0;
+        (*info)[1].dims[1] = TILE_INFO_SIZE;
+        (*info)[1].precision = I32;
+    } else if (parameters.maskResize != MaskResize::NONE) {
+        (*info)[1].name = ORIGINAL_SIZE_TENSOR_NAME;
+        (*info)[1].dimsCount = 2;
+        (*info)[1].dims = (uint64_t*)malloc((*info)[1].dimsCount * sizeof(uint64_t));
+        NODE_ASSERT(((*info)[1].dims) != nullptr, "malloc has failed");
+        // one row per image or single row shared by batch
+        (*info)[1].dims[0] = parameters.maxBatchSize == 1 ? 1 : 0;
+        (*info)[1].dims[1] = ORIGINAL_SIZE_SIZE;
+        (*info)[1].precision = I32;
+    }
     return 0;
 }
 
 int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
-    // // Parameters reading
-    int _sourceImageHeight = get_int_parameter("input_h", params, paramsCount, -1);
-    int _sourceImageWidth = get_int_parameter("input_w", params, paramsCount, -1);
-    NODE_ASSERT(_sourceImageHeight > 0 || _sourceImageHeight == -1, "Source image height - when specified, must be larger than 0");
-    NODE_ASSERT(_sourceImageWidth > 0 || _sourceImageHeight == -1, "Source image width - when specified, must be larger than 0");
+    DeepLabPostprocessingParameters parameters;
+    NODE_ASSERT(readParameters(params, paramsCount, parameters) == 0, "node parameters are invalid");
+
+    if (parameters.maskEncoding == MaskEncoding::RLE) {
+        *infoCount = 2;
+        *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
+        NODE_ASSERT((*info) != nullptr, "malloc has failed");
 
-    int _numClass = get_int_parameter("num_class", params, paramsCount, -1);
-    NODE_ASSERT(_numClass > 0, "Number of classes - must be larger than 0");
+        (*info)[0].name = MASK_RLE_TENSOR_NAME;
+        (*info)[0].dimsCount = 2;
+        (*info)[0].dims = (uint64_t*)malloc((*info)[0].dimsCount * sizeof(uint64_t));
+        NODE_ASSERT(((*info)[0].dims) != nullptr, "malloc has failed");
+        (*info)[0].dims[0] = 0;
+        (*info)[0].dims[1] = 2;
+        (*info)[0].precision = I32;
+
+        (*info)[1].name = MASK_SIZE_TENSOR_NAME;
+        (*info)[1].dimsCount = 2;
+        (*info)[1].dims = (uint64_t*)malloc((*info)[1].dimsCount * sizeof(uint64_t));
+        NODE_ASSERT(((*info)[1].dims) != nullptr, "malloc has failed");
+        (*info)[1].dims[0] = parameters.maxBatchSize == 1 || parameters.tiling ? 1 : 0;
+        (*info)[1].dims[1] = ORIGINAL_SIZE_SIZE;
+        (*info)[1].precision = I32;
+        return 0;
+    }
 
     *infoCount = 1;
     *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
     NODE_ASSERT((*info) != nullptr, "malloc has failed");
 
+    // resized and stitched masks have size of original image
+    // batched masks have additional batch dimension, stitched mask is single image
+    bool isSizeKnown = parameters.maskResize == MaskResize::NONE && !parameters.tiling;
+    bool isBatched = parameters.maxBatchSize > 1 && !parameters.tiling;
     (*info)[0].name = TENSOR_NAME;
-    (*info)[0].dimsCount = 2;
+    (*info)[0].dimsCount = isBatched ? 3 : 2;
     (*info)[0].dims = (uint64_t*)malloc((*info)->dimsCount * sizeof(uint64_t));
     NODE_ASSERT(((*info)[0].dims) != nullptr, "malloc has failed");
-    (*info)[0].dims[0] = 513;
-    (*info)[0].dims[1] = 513;
+    if (isBatched) {
+        (*info)[0].dims[0] = 0;
+    }
+    (*info)[0].dims[isBatched ? 1 : 0] = isSizeKnown && parameters.sourceImageHeight > 0 ? parameters.sourceImageHeight : 0;
+    (*info)[0].dims[isBatched ? 2 : 1] = isSizeKnown && parameters.sourceImageWidth > 0 ? parameters.sourceImageWidth : 0;
     (*info)[0].precision = U8;
 
     return 0;
 }
 
 int release(void* ptr, void* customNodeLibraryInternalManager) {
-    if (ptr != nullptr){
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+    if (internalManager == nullptr || !internalManager->releaseBuffer(ptr)) {
         free(ptr);
     }
-    ptr = nullptr;
     return 0;
 }
@@ -13,92 +13,156 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //*****************************************************************************
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <shared_mutex>
 #include <string>
 
 #include "../../custom_node_interface.h"
+#include "../common/async_executor_utils.hpp"
+#include "../common/buffersqueue_utils.hpp"
+#include "../common/custom_node_library_internal_manager.hpp"
+#include "../common/image_kernels.hpp"
+#include "../common/image_preprocessing_parameters.hpp"
 #include "../common/opencv_utils.hpp"
+#include "../common/parallel.hpp"
+#include "../common/preallocated_outputs_utils.hpp"
+#include "../common/tiling.hpp"
 #include "../common/utils.hpp"
 #include "opencv2/opencv.hpp"
 
-static constexpr const char* TENSOR_NAME = "image";
+using CustomNodeLibraryInternalManager = ovms::custom_nodes_common::CustomNodeLibraryInternalManager;
+using ColorOrder = ovms::custom_nodes_common::ColorOrder;
+using ImageLayout = ovms::custom_nodes_common::ImageLayout;
+using ImagePreprocessingParameters = ovms::custom_nodes_common::ImagePreprocessingParameters;
+using Tile = ovms::custom_nodes_common::Tile;
+using ovms::custom_nodes_common::TILE_INFO_SIZE;
 
-int initialize(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+static constexpr const char* TENSOR_NAME = "image";
+// original image height and width - used by postprocessing to resize mask back to original image
+static constexpr const char* ORIGINAL_SIZE_TENSOR_NAME = "original_size";
+static constexpr int ORIGINAL_SIZE_SIZE = 2;
+// position of each tile and size of original image, replaces original_size in tiling mode
+static constexpr const char* TILE_INFO_TENSOR_NAME = "tile_info";
+// tiles of image smaller than tile are padded with black
+static constexpr float TILE_PAD_VALUE = 0.0f;
+
+static constexpr const char* OUTPUT_TENSOR_NAME = "output_tensor";
+static constexpr const char* OUTPUT_IMAGE_NAME = "output_image";
+static constexpr const char* OUTPUT_IMAGE_DIMS_NAME = "output_image_dims";
+static constexpr const char* OUTPUT_ORIGINAL_SIZE_NAME = "output_original_size";
+static constexpr const char* OUTPUT_ORIGINAL_SIZE_DIMS_NAME = "output_original_size_dims";
+static constexpr const char* OUTPUT_TILE_INFO_NAME = "output_tile_info";
+
+static int initializeBuffersQueues(CustomNodeLibraryInternalManager* internalManager, const ImagePreprocessingParameters& parameters, const struct CustomNodeParam* params, int paramsCount) {
+    // reading parameters to determine BuffersQueues sizes
+    int queueSize = get_int_parameter("buffer_queue_size", params, paramsCount, 24);
+    NODE_ASSERT(queueSize > 0, "buffer queue size must be larger than 0");
+    auto buffersQueueOptions = get_buffers_queue_options(params, paramsCount, queueSize);
+    // huge pages and NUMA binding are meant for large data buffers, small metadata pools keep default options
+    const ovms::custom_nodes_common::BuffersQueueOptions metadataBuffersQueueOptions{};
+
+    // creating BuffersQueues for output: image
+    // without target size specified output shape is dynamic and is allocated on heap
+    if (parameters.targetImageHeight != -1 && parameters.targetImageWidth != -1) {
+        uint64_t imageByteSize = sizeof(float) * parameters.maxBatchSize * parameters.targetImageHeight * parameters.targetImageWidth * parameters.targetImageColorChannels;
+        NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_IMAGE_NAME, imageByteSize, queueSize, buffersQueueOptions), "output image buffer creation failed");
+    }
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_IMAGE_DIMS_NAME, 4 * sizeof(uint64_t), queueSize, metadataBuffersQueueOptions), "output image dims buffer creation failed");
+    // in tiling mode max_batch_size is number of tiles of single image
+    if (parameters.tiling) {
+        NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_TILE_INFO_NAME, parameters.maxBatchSize * TILE_INFO_SIZE * sizeof(int32_t), queueSize, metadataBuffersQueueOptions), "output tile info buffer creation failed");
+    } else {
+        NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_ORIGINAL_SIZE_NAME, parameters.maxBatchSize * ORIGINAL_SIZE_SIZE * sizeof(int32_t), queueSize, metadataBuffersQueueOptions), "output original size buffer creation failed");
+    }
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_ORIGINAL_SIZE_DIMS_NAME, 2 * sizeof(uint64_t), queueSize, metadataBuffersQueueOptions), "output original size dims buffer creation failed");
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_TENSOR_NAME, 2 * sizeof(CustomNodeTensor), queueSize, metadataBuffersQueueOptions), "output tensor buffer creation failed");
     return 0;
 }
 
-int deinitialize(void* customNodeLibraryInternalManager) {
+static int initializeParametersAndBuffersQueues(CustomNodeLibraryInternalManager* internalManager, const struct CustomNodeParam* params, int paramsCount) {
+    // parameters are parsed once here, execute() only reads them
+    // messages of initialization are filtered by settings of initialized node
+    ovms::custom_nodes_common::LogSettings::Scope logScope(internalManager->getLogSettings());
+    NODE_ASSERT(configure_logger(internalManager->getLogSettings(), params, paramsCount) == 0, "logger configuration failed");
+    NODE_ASSERT(configure_thread_pool(params, paramsCount) == 0, "thread pool configuration failed");
+    std::unique_ptr<ImagePreprocessingParameters> parameters = std::make_unique<ImagePreprocessingParameters>();
+    NODE_ASSERT(read_image_preprocessing_parameters(params, paramsCount, *parameters) == 0, "node parameters are invalid");
+    NODE_ASSERT(read_tiling_parameters(params, paramsCount, *parameters) == 0, "tiling parameters are invalid");
+    NODE_ASSERT(initializeBuffersQueues(internalManager, *parameters, params, paramsCount) == 0, "buffers queues creation failed");
+    internalManager->setParameters(std::move(parameters));
     return 0;
 }
 
-int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
-    // Parameters reading
+static int initializeInternalManager(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    // creating InternalManager instance
+    std::unique_ptr<CustomNodeLibraryInternalManager> internalManager = std::make_unique<CustomNodeLibraryInternalManager>();
+    NODE_ASSERT(internalManager != nullptr, "internalManager allocation failed");
+    NODE_ASSERT(initializeParametersAndBuffersQueues(internalManager.get(), params, paramsCount) == 0, "internalManager initialization failed");
+    create_async_executor(internalManager.get(), params, paramsCount);
+    *customNodeLibraryInternalManager = internalManager.release();
+    return 0;
+}
 
-    // Image size.
-    //
-    // If not specified (-1), the image will not be resized.
-    // When specified, cv::resize is used to resize an image.
-    // Original image size must not specified, input size is dynamic.
-    int _targetImageHeight = get_int_parameter("target_image_height", params, paramsCount, -1);
-    int _targetImageWidth = get_int_parameter("target_image_width", params, paramsCount, -1);
-    NODE_ASSERT(_targetImageHeight > 0 || _targetImageHeight == -1, "target image height - when specified, must be larger than 0");
-    NODE_ASSERT(_targetImageWidth > 0 || _targetImageWidth == -1, "target image width - when specified, must be larger than 0");
-
-    // Color order.
-    //
-    // Possible orders: BGR (default), RGB and GRAY.
-    // Depending on the order, number of color channels will be selected - 3 for BGR/RGB and 1 for GRAY.
-    std::string originalImageColorOrder = get_string_parameter("original_image_color_order", params, paramsCount, "BGR");
-    std::string targetImageColorOrder = get_string_parameter("target_image_color_order", params, paramsCount);
-    targetImageColorOrder = targetImageColorOrder.empty() ? originalImageColorOrder : targetImageColorOrder;
-    NODE_ASSERT(originalImageColorOrder == "BGR" || originalImageColorOrder == "RGB" || originalImageColorOrder == "GRAY", "original image layout must be BGR, RGB or GRAY");
-    NODE_ASSERT(targetImageColorOrder == "BGR" || targetImageColorOrder == "RGB" || targetImageColorOrder == "GRAY", "target image layout must be BGR, RGB or GRAY");
-    uint64_t targetImageColorChannels = targetImageColorOrder == "GRAY" ? 1 : 3;
-
-    // Image layout.
-    //
-    // Possible layouts: NCHW and NHWC.
-    // Since OpenCV is used for transformations, image will be converted to cv::Mat.
-    // The container requires the data in NHWC format, so selecting input layout NCHW will convert data to NHWC, therefore decrease performance.
-    // Selecting target layout NCHW will also perform conversion before copying data into output.
-    std::string originalImageLayout = get_string_parameter("original_image_layout", params, paramsCount);
-    std::string targetImageLayout = get_string_parameter("target_image_layout", params, paramsCount);
-    targetImageLayout = targetImageLayout.empty() ? originalImageLayout : targetImageLayout;
-    NODE_ASSERT(originalImageLayout == "NCHW" || originalImageLayout == "NHWC", "original image layout must be NCHW or NHWC");
-    NODE_ASSERT(targetImageLayout == "NCHW" || targetImageLayout == "NHWC", "target image layout must be NCHW or NHWC");
+static int reinitializeInternalManagerIfNecessary(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(*customNodeLibraryInternalManager);
+    // executions are blocked while parameters and queues are replaced, buffers still in flight are returned to replaced queues
+    std::unique_lock<std::shared_timed_mutex> lock(internalManager->getInternalManagerLock());
+    NODE_ASSERT(initializeParametersAndBuffersQueues(internalManager, params, paramsCount) == 0, "internalManager reinitialization failed");
+    return 0;
+}
 
-    // Scale.
-    //
-    // When specified, all pixel values will be divided by this value.
-    bool isScaleDefined = false;
-    float scale = get_float_parameter("scale", params, paramsCount, isScaleDefined, -1);
-    NODE_ASSERT(scale != 0, "cannot divide by scale equal to 0");
-
-    // Scale values.
-    //
-    // Smilar to scale but scale value should be provided per color channel.
-    std::vector<float> scaleValues = get_float_list_parameter("scale_values", params, paramsCount);
-    for (auto scale : scaleValues) {
-        NODE_ASSERT(scale != 0, "cannot divide by scale equal to 0");
+int initialize(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    if (*customNodeLibraryInternalManager == nullptr) {
+        return initializeInternalManager(customNodeLibraryInternalManager, params, paramsCount);
     }
+    return reinitializeInternalManagerIfNecessary(customNodeLibraryInternalManager, params, paramsCount);
+}
 
-    // Mean values.
-    //
-    // If not specified, the image will not be scaled.
-    // When specified, all pixel values will be subtracted by this value per channel.
-    // The exact meaning and order of channels depend on input image.
-    std::vector<float> meanValues = get_float_list_parameter("mean_values", params, paramsCount);
+int deinitialize(void* customNodeLibraryInternalManager) {
+    // deallocate InternalManager and its contents
+    if (customNodeLibraryInternalManager != nullptr) {
+        CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+        delete internalManager;
+    }
+    return 0;
+}
 
-    // Debug flag for additional logging.
-    bool debugMode = get_string_parameter("debug", params, paramsCount) == "true";
+// Image output is written into memory provided by caller when it is preallocated, otherwise it is returned in outputs.
+static int processImages(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor* preallocatedOutputs, int preallocatedOutputsCount,
+    struct CustomNodeTensor** outputs, int* outputsCount, void* customNodeLibraryInternalManager) {
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+    NODE_ASSERT(internalManager != nullptr, "internalManager is not initialized");
+    std::shared_lock<std::shared_timed_mutex> lock(internalManager->getInternalManagerLock());
+    ovms::custom_nodes_common::LogSettings::Scope logScope(internalManager->getLogSettings());
+
+    // Parameters are parsed and validated in initialize()
+    const ImagePreprocessingParameters* parameters = internalManager->getParameters<ImagePreprocessingParameters>();
+    NODE_ASSERT(parameters != nullptr, "node parameters are not initialized");
+    const int _targetImageHeight = parameters->targetImageHeight;
+    const int _targetImageWidth = parameters->targetImageWidth;
+    const ColorOrder originalImageColorOrder = parameters->originalImageColorOrder;
+    const ColorOrder targetImageColorOrder = parameters->targetImageColorOrder;
+    const uint64_t targetImageColorChannels = parameters->targetImageColorChannels;
+    const ImageLayout originalImageLayout = parameters->originalImageLayout;
+    const ImageLayout targetImageLayout = parameters->targetImageLayout;
+    const bool isScaleDefined = parameters->isScaleDefined;
+    const float scale = parameters->scale;
+    const std::vector<float>& scaleValues = parameters->scaleValues;
+    const std::vector<float>& meanValues = parameters->meanValues;
+    const bool debugMode = parameters->debugMode;
 
     // ------------ validation start -------------
     NODE_ASSERT(inputsCount == 1, "there must be exactly one input");
     const CustomNodeTensor* imageTensor = inputs;
     NODE_ASSERT(std::strcmp(imageTensor->name, TENSOR_NAME) == 0, "node input name is wrong");
     NODE_ASSERT(imageTensor->dimsCount == 4, "image tensor shape must have 4 dimensions")
-    NODE_ASSERT(imageTensor->dims[0] == 1, "image tensor must have batch size equal to 1")
+    NODE_ASSERT(imageTensor->precision == FP32 || imageTensor->precision == U8, "image tensor precision must be FP32 or U8");
+    const uint64_t batchSize = imageTensor->dims[0];
+    NODE_ASSERT(batchSize > 0, "image tensor batch size must be positive");
 
     uint64_t originalImageHeight = 0;
     uint64_t originalImageWidth = 0;
@@ -106,28 +170,25 @@ int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct Custo
     
     // std::cout << "Image tensor dims : " << imageTensor->dims[0] << ", " << imageTensor->dims[1] << ", " << imageTensor->dims[2] << ", " << imageTensor->dims[3] << std::endl;    
     
-    if (originalImageLayout == "NCHW") {
+    if (originalImageLayout == ImageLayout::NCHW) {
         originalImageColorChannels = imageTensor->dims[1];
         originalImageHeight = imageTensor->dims[2];
         originalImageWidth = imageTensor->dims[3];
-    } else if (originalImageLayout == "NHWC") {
+    } else {
         originalImageHeight = imageTensor->dims[1];
         originalImageWidth = imageTensor->dims[2];
         originalImageColorChannels = imageTensor->dims[3];
-    } else {
-        std::cout << "original image layout: " << originalImageLayout << " is unsupported" << std::endl;
-        return 1;
     }
 
     NODE_ASSERT(originalImageHeight > 0 && originalImageWidth > 0, "original image size must be positive");
     // std::cout << "Original Image Color Channels : " << originalImageColorChannels << std::endl;
     NODE_ASSERT(originalImageColorChannels == 1 || originalImageColorChannels == 3, "original image color channels must be 1 or 3");
-    NODE_ASSERT(originalImageHeight * originalImageWidth * originalImageColorChannels * sizeof(float) == imageTensor->dataBytes, "number of input bytes does not match input shape");
+    NODE_ASSERT(batchSize * originalImageHeight * originalImageWidth * originalImageColorChannels * image_precision_size(imageTensor->precision) == imageTensor->dataBytes, "number of input bytes does not match input shape");
 
-    if (originalImageColorOrder == "GRAY") {
+    if (originalImageColorOrder == ColorOrder::GRAY) {
         NODE_ASSERT(originalImageColorChannels == 1, "for color order GRAY color channels must be equal 1");
     }
-    if (originalImageColorOrder == "BGR" || originalImageColorOrder == "RGB") {
+    if (originalImageColorOrder == ColorOrder::BGR || originalImageColorOrder == ColorOrder::RGB) {
         NODE_ASSERT(originalImageColorChannels == 3, "for color order BGR/RGB color channels must be equal to 3");
     }
 
@@ -141,125 +202,163 @@ int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct Custo
     auto targetImageResolution = targetImageHeight * targetImageWidth;
 
     if (debugMode) {
-        std::cout << "Original image size: " << cv::Size2i(originalImageWidth, originalImageHeight) << std::endl;
-        std::cout << "Original image resolution: " << originalImageResolution << std::endl;
-        std::cout << "Original image color channels: " << originalImageColorChannels << std::endl;
-        std::cout << "Original image color order: " << originalImageColorOrder << std::endl;
-        std::cout << "Original image layout: " << originalImageLayout << std::endl;
-        std::cout << "Target image size: " << cv::Size2i(targetImageWidth, targetImageHeight) << std::endl;
-        std::cout << "Target image resolution: " << targetImageResolution << std::endl;
-        std::cout << "Target image color channels: " << targetImageColorChannels << std::endl;
-        std::cout << "Target image color order: " << targetImageColorOrder << std::endl;
-        std::cout << "Target image layout: " << targetImageLayout << std::endl;
-        std::cout << "Scale: " << (isScaleDefined ? std::to_string(scale) : "not defined") << std::endl;
-        std::cout << "Scale values: " << floatListToString(scaleValues) << std::endl;
-        std::cout << "Mean values: " << floatListToString(meanValues) << std::endl;
+        NODE_LOG_DEBUG("Original image size: " << cv::Size2i(originalImageWidth, originalImageHeight));
+        NODE_LOG_DEBUG("Original image resolution: " << originalImageResolution);
+        NODE_LOG_DEBUG("Original image color channels: " << originalImageColorChannels);
+        NODE_LOG_DEBUG("Original image color order: " << to_string(originalImageColorOrder));
+        NODE_LOG_DEBUG("Original image layout: " << to_string(originalImageLayout));
+        NODE_LOG_DEBUG("Target image size: " << cv::Size2i(targetImageWidth, targetImageHeight));
+        NODE_LOG_DEBUG("Target image resolution: " << targetImageResolution);
+        NODE_LOG_DEBUG("Target image color channels: " << targetImageColorChannels);
+        NODE_LOG_DEBUG("Target image color order: " << to_string(targetImageColorOrder));
+        NODE_LOG_DEBUG("Target image layout: " << to_string(targetImageLayout));
+        NODE_LOG_DEBUG("Scale: " << (isScaleDefined ? std::to_string(scale) : "not defined"));
+        NODE_LOG_DEBUG("Scale values: " << floatListToString(scaleValues));
+        NODE_LOG_DEBUG("Mean values: " << floatListToString(meanValues));
     }
     // ------------- validation end ---------------
 
-    // Prepare cv::Mat out of imageTensor input.
-    // In case input is in NCHW format, perform reordering to NHWC.
-    cv::Mat image = cv::Mat(originalImageHeight, originalImageWidth, originalImageColorChannels == 1 ? CV_32FC1 : CV_32FC3);
-    
-    if (originalImageLayout == "NCHW") {
-        reorder_to_nhwc_2<float>((float*)imageTensor->data, (float*)image.data, originalImageHeight, originalImageWidth, originalImageColorChannels);
-    } else {
-        std::memcpy(image.data, imageTensor->data, imageTensor->dataBytes);
+    // In tiling mode single image is split into tiles of target size returned as batch, otherwise each image of batch is resized.
+    const bool tiling = parameters->tiling;
+    std::vector<Tile> tiles;
+    if (tiling) {
+        NODE_ASSERT(batchSize == 1, "tiling supports single image in batch");
+        tiles = ovms::custom_nodes_common::compute_tiles(originalImageHeight, originalImageWidth, targetImageHeight, targetImageWidth, parameters->tileOverlap);
+        if (debugMode) {
+            NODE_LOG_DEBUG("Tiles: " << tiles.size() << ", overlap: " << parameters->tileOverlap);
+        }
     }
+    const uint64_t outputBatchSize = tiling ? tiles.size() : batchSize;
 
-    // Change color order and number of channels.
-    static const std::map<std::pair<std::string, std::string>, int> colors = {
-        {{"GRAY", "BGR"}, cv::COLOR_GRAY2BGR},
-        {{"GRAY", "RGB"}, cv::COLOR_GRAY2RGB},
-        {{"BGR", "RGB"}, cv::COLOR_BGR2RGB},
-        {{"BGR", "GRAY"}, cv::COLOR_BGR2GRAY},
-        {{"RGB", "BGR"}, cv::COLOR_RGB2BGR},
-        {{"RGB", "GRAY"}, cv::COLOR_RGB2GRAY},
+    // Prepare output tensor
+    uint64_t targetImageSize = targetImageHeight * targetImageWidth * targetImageColorChannels;
+    uint64_t byteSize = sizeof(float) * outputBatchSize * targetImageSize;
+    const bool nchw = targetImageLayout == ImageLayout::NCHW;
+    const uint64_t imageShape[4] = {outputBatchSize, nchw ? targetImageColorChannels : targetImageHeight, nchw ? targetImageHeight : targetImageWidth, nchw ? targetImageWidth : targetImageColorChannels};
+    CustomNodeTensor* preallocatedImage = find_preallocated_output(preallocatedOutputs, preallocatedOutputsCount, TENSOR_NAME);
+    float* buffer = nullptr;
+    if (preallocatedImage != nullptr) {
+        NODE_ASSERT(prepare_preallocated_output(*preallocatedImage, byteSize, imageShape, 4, FP32), "preallocated image output is too small");
+        buffer = reinterpret_cast<float*>(preallocatedImage->data);
+    } else {
+        NODE_ASSERT(get_buffer<float>(internalManager, &buffer, OUTPUT_IMAGE_NAME, byteSize), "buffer acquire failed");
+    }
+    // preallocated image belongs to caller
+    auto releaseImage = [&]() {
+        if (preallocatedImage == nullptr) {
+            release(buffer, internalManager);
+        }
     };
 
-    if (originalImageColorOrder != targetImageColorOrder) {
-        const auto& colorIt = colors.find({originalImageColorOrder, targetImageColorOrder});
-        NODE_ASSERT(colorIt != colors.end(), "unsupported color conversion");
-        cv::cvtColor(image, image, colorIt->second);
+    // Images of batch are independent, each one is transformed by single thread.
+    uint64_t originalImageBytes = imageTensor->dataBytes / batchSize;
+    std::atomic<int> failures{0};
+    if (tiling) {
+        failures = tile_image(imageTensor->data, imageTensor->precision, originalImageHeight, originalImageWidth, originalImageColorChannels,
+            tiles, *parameters, TILE_PAD_VALUE, buffer);
+    } else {
+        ovms::custom_nodes_common::parallel_for(batchSize, parameters->batchThreads, [&](size_t i) {
+            if (transform_image(imageTensor->data + i * originalImageBytes, imageTensor->precision, originalImageHeight, originalImageWidth, originalImageColorChannels,
+                    targetImageHeight, targetImageWidth, *parameters, buffer + i * targetImageSize) != 0) {
+                failures++;
+            }
+        });
     }
-
-    // Perform procesesing with scale and mean values. If scale and scaleValues provided only scaleValues are used for scaling.
-    // If scale and meanValues provided mean values are subtracted from pixels first then scaling is made.
-    // Scaling will be applied before resize if target resolution is smaller.
-    if ((isScaleDefined || scaleValues.size() > 0 || meanValues.size() > 0) && originalImageResolution < targetImageResolution) {
-        if (debugMode) {
-            std::cout << "Performing scaling before resize operation" << std::endl;
-        }
-        NODE_ASSERT(scale_image(isScaleDefined, scale, meanValues, scaleValues, image), "Error during image scaling");
+    if (failures > 0) {
+        releaseImage();
+        return 1;
     }
 
-    // // Scaling, normalizing directly
-    // cv::Scalar mean_val = cv::Scalar(0.485, 0.456, 0.406); // 예: R, G, B 채널의 mean
-    // cv::Scalar stddev_val = cv::Scalar(0.229, 0.224, 0.225); // 예: R, G, B 채널의 std
-    // std::vector<cv::Mat> channels(3);
-    // cv::split(image, channels);
-    // for (int i = 0; i < 3; ++i) {
-    //     channels[i] = (channels[i] / 255.0f - mean_val[i]) / stddev_val[i]; // 정규화 수행
-    // }
-    // cv::merge(channels, image);  // 채널 병합
-
-
-    // Perform resize operation.
-    if (originalImageHeight != targetImageHeight || originalImageWidth != targetImageWidth) {
-        cv::resize(image, image, cv::Size(targetImageWidth, targetImageHeight));
+    // Side output holds original size of each image, or position of each tile in tiling mode.
+    // All images of batch have the same size, it is repeated for each of them.
+    const uint64_t infoSize = tiling ? TILE_INFO_SIZE : ORIGINAL_SIZE_SIZE;
+    const uint64_t infoBytes = outputBatchSize * infoSize * sizeof(int32_t);
+    int32_t* originalSize = nullptr;
+    if (!get_buffer<int32_t>(internalManager, &originalSize, tiling ? OUTPUT_TILE_INFO_NAME : OUTPUT_ORIGINAL_SIZE_NAME, infoBytes)) {
+        releaseImage();
+        return 1;
     }
-
-    // Scaling should be applied after resize if target resolution is smaller.
-    if ((isScaleDefined || scaleValues.size() > 0 || meanValues.size() > 0) && originalImageResolution >= targetImageResolution) {
-        if (debugMode) {
-            std::cout << "Performing scaling after resize operation" << std::endl;
+    if (tiling) {
+        ovms::custom_nodes_common::write_tile_info(tiles, originalImageHeight, originalImageWidth, originalSize);
+    } else {
+        for (uint64_t i = 0; i < batchSize; i++) {
+            originalSize[i * ORIGINAL_SIZE_SIZE] = originalImageHeight;
+            originalSize[i * ORIGINAL_SIZE_SIZE + 1] = originalImageWidth;
         }
-        NODE_ASSERT(scale_image(isScaleDefined, scale, meanValues, scaleValues, image), "Error during image scaling");
     }
 
-    // Prepare output tensor
-    uint64_t byteSize = sizeof(float) * targetImageHeight * targetImageWidth * targetImageColorChannels;
-    NODE_ASSERT(image.total() * image.elemSize() == byteSize, "buffer size differs");
-    float* buffer = (float*)malloc(byteSize);
-    NODE_ASSERT(buffer != nullptr, "malloc has failed");
-
-    if (targetImageLayout == "NCHW") {
-        reorder_to_nchw_2<float>((float*)image.data, (float*)buffer, image.rows, image.cols, image.channels());
-    } else {
-        std::memcpy((uint8_t*)buffer, image.data, byteSize);
+    *outputsCount = preallocatedImage != nullptr ? 1 : 2;
+    if (!get_buffer<struct CustomNodeTensor>(internalManager, outputs, OUTPUT_TENSOR_NAME, *outputsCount * sizeof(CustomNodeTensor))) {
+        releaseImage();
+        release(originalSize, internalManager);
+        return 1;
     }
 
-    *outputsCount = 1;
-    *outputs = (struct CustomNodeTensor*)malloc(*outputsCount * sizeof(CustomNodeTensor));
+    CustomNodeTensor* imageOutput = nullptr;
+    if (preallocatedImage == nullptr) {
+        CustomNodeTensor& output = (*outputs)[0];
+        imageOutput = &output;
+        output.name = TENSOR_NAME;
+        output.data = reinterpret_cast<uint8_t*>(buffer);
+        output.dataBytes = byteSize;
+        output.dimsCount = 4;
+        if (!get_buffer<uint64_t>(internalManager, &(output.dims), OUTPUT_IMAGE_DIMS_NAME, output.dimsCount * sizeof(uint64_t))) {
+            releaseImage();
+            release(originalSize, internalManager);
+            release(*outputs, internalManager);
+            return 1;
+        }
+        std::copy(imageShape, imageShape + 4, output.dims);
+        output.precision = FP32;
+    }
 
-    if ((*outputs) == nullptr) {
-        std::cout << "malloc has failed" << std::endl;
-        free(buffer);
+    CustomNodeTensor& originalSizeOutput = (*outputs)[*outputsCount - 1];
+    originalSizeOutput.name = tiling ? TILE_INFO_TENSOR_NAME : ORIGINAL_SIZE_TENSOR_NAME;
+    originalSizeOutput.data = reinterpret_cast<uint8_t*>(originalSize);
+    originalSizeOutput.dataBytes = infoBytes;
+    originalSizeOutput.dimsCount = 2;
+    if (!get_buffer<uint64_t>(internalManager, &(originalSizeOutput.dims), OUTPUT_ORIGINAL_SIZE_DIMS_NAME, originalSizeOutput.dimsCount * sizeof(uint64_t))) {
+        releaseImage();
+        if (imageOutput != nullptr) {
+            release(imageOutput->dims, internalManager);
+        }
+        release(originalSize, internalManager);
+        release(*outputs, internalManager);
         return 1;
     }
-
-    CustomNodeTensor& output = (*outputs)[0];
-    output.name = TENSOR_NAME;
-    output.data = reinterpret_cast<uint8_t*>(buffer);
-    output.dataBytes = byteSize;
-    output.dimsCount = 4;
-    output.dims = (uint64_t*)malloc(output.dimsCount * sizeof(uint64_t));
-    NODE_ASSERT(output.dims != nullptr, "malloc has failed");
-    output.dims[0] = 1;
-    if (targetImageLayout == "NCHW") {
-        output.dims[1] = targetImageColorChannels;
-        output.dims[2] = targetImageHeight;
-        output.dims[3] = targetImageWidth;
-    } else {
-        output.dims[1] = targetImageHeight;
-        output.dims[2] = targetImageWidth;
-        output.dims[3] = targetImageColorChannels;
+    originalSizeOutput.dims[0] = outputBatchSize;
+    originalSizeOutput.dims[1] = infoSize;
+    originalSizeOutput.precision = I32;
+    if (debugMode) {
+        internalManager->logStatistics();
     }
-    output.precision = FP32;
     return 0;
 }
 
+int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    return processImages(inputs, inputsCount, nullptr, 0, outputs, outputsCount, customNodeLibraryInternalManager);
+}
+
+int executeInto(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor* preallocatedOutputs, int preallocatedOutputsCount,
+    struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    NODE_ASSERT(preallocated_outputs_supported(preallocatedOutputs, preallocatedOutputsCount, {TENSOR_NAME}), "only image output can be preallocated");
+    return processImages(inputs, inputsCount, preallocatedOutputs, preallocatedOutputsCount, outputs, outputsCount, customNodeLibraryInternalManager);
+}
+
+int executeAsync(const struct CustomNodeTensor* inputs, int inputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager,
+    CustomNodeCompletionCallback callback, void* userContext) {
+    return execute_async(execute, inputs, inputsCount, params, paramsCount, customNodeLibraryInternalManager, callback, userContext);
+}
+
+int getCapabilities(struct CustomNodeCapabilities* capabilities, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    return set_capabilities(capabilities, CUSTOM_NODE_CAPABILITY_EXECUTE_INTO | CUSTOM_NODE_CAPABILITY_EXECUTE_ASYNC);
+}
+
 int getInputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    ImagePreprocessingParameters parameters;
+    NODE_ASSERT(read_image_preprocessing_parameters(params, paramsCount, parameters) == 0, "node parameters are invalid");
+    NODE_ASSERT(read_tiling_parameters(params, paramsCount, parameters) == 0, "tiling parameters are invalid");
+
     *infoCount = 1;
     *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
     NODE_ASSERT((*info) != nullptr, "malloc has failed");
@@ -268,11 +367,12 @@ int getInputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const stru
     (*info)[0].dimsCount = 4;
     (*info)[0].dims = (uint64_t*)malloc((*info)->dimsCount * sizeof(uint64_t));
     NODE_ASSERT(((*info)[0].dims) != nullptr, "malloc has failed");
-    (*info)[0].dims[0] = 1;
+    // tiled image is single, max_batch_size limits its tiles then
+    (*info)[0].dims[0] = parameters.maxBatchSize == 1 || parameters.tiling ? 1 : 0;
     (*info)[0].dims[1] = 0;
     (*info)[0].dims[2] = 0;
     (*info)[0].dims[3] = 0;
-    (*info)[0].precision = FP32;
+    (*info)[0].precision = parameters.originalImagePrecision;
     return 0;
 }
 
@@ -294,8 +394,13 @@ int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const str
     targetImageLayout = targetImageLayout.empty() ? originalImageLayout : targetImageLayout;
     NODE_ASSERT(originalImageLayout == "NCHW" || originalImageLayout == "NHWC", "original image layout must be NCHW or NHWC");
     NODE_ASSERT(targetImageLayout == "NCHW" || targetImageLayout == "NHWC", "target image layout must be NCHW or NHWC");
+    int maxBatchSize = get_int_parameter("max_batch_size", params, paramsCount, 1);
+    NODE_ASSERT(maxBatchSize > 0, "max batch size must be larger than 0");
+    // number of tiles depends on image size
+    bool tiling = get_string_parameter("tiling", params, paramsCount, "false") == "true";
+    uint64_t batchSize = maxBatchSize == 1 && !tiling ? 1 : 0;
 
-    *infoCount = 1;
+    *infoCount = 2;
     *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
     NODE_ASSERT((*info) != nullptr, "malloc has failed");
 
@@ -303,7 +408,7 @@ int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const str
     (*info)[0].dimsCount = 4;
     (*info)[0].dims = (uint64_t*)malloc((*info)->dimsCount * sizeof(uint64_t));
     NODE_ASSERT(((*info)[0].dims) != nullptr, "malloc has failed");
-    (*info)[0].dims[0] = 1;
+    (*info)[0].dims[0] = batchSize;
 
     if (targetImageLayout == "NHWC") {
         (*info)[0].dims[1] = targetImageHeight == -1 ? 0 : targetImageHeight;
@@ -317,13 +422,21 @@ int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const str
 
     (*info)[0].precision = FP32;
 
+    (*info)[1].name = tiling ? TILE_INFO_TENSOR_NAME : ORIGINAL_SIZE_TENSOR_NAME;
+    (*info)[1].dimsCount = 2;
+    (*info)[1].dims = (uint64_t*)malloc((*info)[1].dimsCount * sizeof(uint64_t));
+    NODE_ASSERT(((*info)[1].dims) != nullptr, "malloc has failed");
+    (*info)[1].dims[0] = batchSize;
+    (*info)[1].dims[1] = tiling ? TILE_INFO_SIZE : ORIGINAL_SIZE_SIZE;
+    (*info)[1].precision = I32;
+
     return 0;
 }
 
 int release(void* ptr, void* customNodeLibraryInternalManager) {
-    if (ptr != nullptr){
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+    if (internalManager == nullptr || !internalManager->releaseBuffer(ptr)) {
         free(ptr);
     }
-    ptr = nullptr;
     return 0;
 }
@@ -13,118 +13,122 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //*****************************************************************************
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <shared_mutex>
 #include <string>
 
 #include "../../custom_node_interface.h"
+#include "../common/async_executor_utils.hpp"
+#include "../common/custom_node_library_internal_manager.hpp"
+#include "../common/image_kernels.hpp"
+#include "../common/image_preprocessing_parameters.hpp"
 #include "../common/opencv_utils.hpp"
+#include "../common/parallel.hpp"
+#include "../common/preallocated_outputs_utils.hpp"
 #include "../common/utils.hpp"
 #include "opencv2/opencv.hpp"
 
+using CustomNodeLibraryInternalManager = ovms::custom_nodes_common::CustomNodeLibraryInternalManager;
+using ColorOrder = ovms::custom_nodes_common::ColorOrder;
+using ImageLayout = ovms::custom_nodes_common::ImageLayout;
+using ImagePreprocessingParameters = ovms::custom_nodes_common::ImagePreprocessingParameters;
+
 static constexpr const char* TENSOR_NAME = "image";
 
-int initialize(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+// Outputs are allocated on heap, InternalManager only keeps parameters parsed in initialize().
+static int initializeParameters(CustomNodeLibraryInternalManager* internalManager, const struct CustomNodeParam* params, int paramsCount) {
+    // messages of initialization are filtered by settings of initialized node
+    ovms::custom_nodes_common::LogSettings::Scope logScope(internalManager->getLogSettings());
+    NODE_ASSERT(configure_logger(internalManager->getLogSettings(), params, paramsCount) == 0, "logger configuration failed");
+    NODE_ASSERT(configure_thread_pool(params, paramsCount) == 0, "thread pool configuration failed");
+    std::unique_ptr<ImagePreprocessingParameters> parameters = std::make_unique<ImagePreprocessingParameters>();
+    NODE_ASSERT(read_image_preprocessing_parameters(params, paramsCount, *parameters) == 0, "node parameters are invalid");
+    internalManager->setParameters(std::move(parameters));
     return 0;
 }
 
-int deinitialize(void* customNodeLibraryInternalManager) {
+int initialize(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    if (*customNodeLibraryInternalManager == nullptr) {
+        std::unique_ptr<CustomNodeLibraryInternalManager> internalManager = std::make_unique<CustomNodeLibraryInternalManager>();
+        NODE_ASSERT(internalManager != nullptr, "internalManager allocation failed");
+        NODE_ASSERT(initializeParameters(internalManager.get(), params, paramsCount) == 0, "internalManager initialization failed");
+        create_async_executor(internalManager.get(), params, paramsCount);
+        *customNodeLibraryInternalManager = internalManager.release();
+        return 0;
+    }
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(*customNodeLibraryInternalManager);
+    std::unique_lock<std::shared_timed_mutex> lock(internalManager->getInternalManagerLock());
+    NODE_ASSERT(initializeParameters(internalManager, params, paramsCount) == 0, "internalManager reinitialization failed");
     return 0;
 }
 
-int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
-    // Parameters reading
-
-    // Image size.
-    //
-    // If not specified (-1), the image will not be resized.
-    // When specified, cv::resize is used to resize an image.
-    // Original image size must not specified, input size is dynamic.
-    int _targetImageHeight = get_int_parameter("target_image_height", params, paramsCount, -1);
-    int _targetImageWidth = get_int_parameter("target_image_width", params, paramsCount, -1);
-    NODE_ASSERT(_targetImageHeight > 0 || _targetImageHeight == -1, "target image height - when specified, must be larger than 0");
-    NODE_ASSERT(_targetImageWidth > 0 || _targetImageWidth == -1, "target image width - when specified, must be larger than 0");
-
-    // Color order.
-    //
-    // Possible orders: BGR (default), RGB and GRAY.
-    // Depending on the order, number of color channels will be selected - 3 for BGR/RGB and 1 for GRAY.
-    std::string originalImageColorOrder = get_string_parameter("original_image_color_order", params, paramsCount, "BGR");
-    std::string targetImageColorOrder = get_string_parameter("target_image_color_order", params, paramsCount);
-    targetImageColorOrder = targetImageColorOrder.empty() ? originalImageColorOrder : targetImageColorOrder;
-    NODE_ASSERT(originalImageColorOrder == "BGR" || originalImageColorOrder == "RGB" || originalImageColorOrder == "GRAY", "original image layout must be BGR, RGB or GRAY");
-    NODE_ASSERT(targetImageColorOrder == "BGR" || targetImageColorOrder == "RGB" || targetImageColorOrder == "GRAY", "target image layout must be BGR, RGB or GRAY");
-    uint64_t targetImageColorChannels = targetImageColorOrder == "GRAY" ? 1 : 3;
-
-    // Image layout.
-    //
-    // Possible layouts: NCHW and NHWC.
-    // Since OpenCV is used for transformations, image will be converted to cv::Mat.
-    // The container requires the data in NHWC format, so selecting input layout NCHW will convert data to NHWC, therefore decrease performance.
-    // Selecting target layout NCHW will also perform conversion before copying data into output.
-    std::string originalImageLayout = get_string_parameter("original_image_layout", params, paramsCount);
-    std::string targetImageLayout = get_string_parameter("target_image_layout", params, paramsCount);
-    targetImageLayout = targetImageLayout.empty() ? originalImageLayout : targetImageLayout;
-    NODE_ASSERT(originalImageLayout == "NCHW" || originalImageLayout == "NHWC", "original image layout must be NCHW or NHWC");
-    NODE_ASSERT(targetImageLayout == "NCHW" || targetImageLayout == "NHWC", "target image layout must be NCHW or NHWC");
-
-    // Scale.
-    //
-    // When specified, all pixel values will be divided by this value.
-    bool isScaleDefined = false;
-    float scale = get_float_parameter("scale", params, paramsCount, isScaleDefined, -1);
-    NODE_ASSERT(scale != 0, "cannot divide by scale equal to 0");
-
-    // Scale values.
-    //
-    // Smilar to scale but scale value should be provided per color channel.
-    std::vector<float> scaleValues = get_float_list_parameter("scale_values", params, paramsCount);
-    for (auto scale : scaleValues) {
-        NODE_ASSERT(scale != 0, "cannot divide by scale equal to 0");
+int deinitialize(void* customNodeLibraryInternalManager) {
+    if (customNodeLibraryInternalManager != nullptr) {
+        CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+        delete internalManager;
     }
+    return 0;
+}
 
-    // Mean values.
-    //
-    // If not specified, the image will not be scaled.
-    // When specified, all pixel values will be subtracted by this value per channel.
-    // The exact meaning and order of channels depend on input image.
-    std::vector<float> meanValues = get_float_list_parameter("mean_values", params, paramsCount);
-
-    // Debug flag for additional logging.
-    bool debugMode = get_string_parameter("debug", params, paramsCount) == "true";
+// Image output is written into memory provided by caller when it is preallocated, otherwise it is returned in outputs.
+static int processImages(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor* preallocatedOutputs, int preallocatedOutputsCount,
+    struct CustomNodeTensor** outputs, int* outputsCount, void* customNodeLibraryInternalManager) {
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+    NODE_ASSERT(internalManager != nullptr, "internalManager is not initialized");
+    std::shared_lock<std::shared_timed_mutex> lock(internalManager->getInternalManagerLock());
+    ovms::custom_nodes_common::LogSettings::Scope logScope(internalManager->getLogSettings());
+
+    // Parameters are parsed and validated in initialize()
+    const ImagePreprocessingParameters* parameters = internalManager->getParameters<ImagePreprocessingParameters>();
+    NODE_ASSERT(parameters != nullptr, "node parameters are not initialized");
+    const int _targetImageHeight = parameters->targetImageHeight;
+    const int _targetImageWidth = parameters->targetImageWidth;
+    const ColorOrder originalImageColorOrder = parameters->originalImageColorOrder;
+    const ColorOrder targetImageColorOrder = parameters->targetImageColorOrder;
+    const uint64_t targetImageColorChannels = parameters->targetImageColorChannels;
+    const ImageLayout originalImageLayout = parameters->originalImageLayout;
+    const ImageLayout targetImageLayout = parameters->targetImageLayout;
+    const bool isScaleDefined = parameters->isScaleDefined;
+    const float scale = parameters->scale;
+    const std::vector<float>& scaleValues = parameters->scaleValues;
+    const std::vector<float>& meanValues = parameters->meanValues;
+    const bool debugMode = parameters->debugMode;
 
     // ------------ validation start -------------
     NODE_ASSERT(inputsCount == 1, "there must be exactly one input");
     const CustomNodeTensor* imageTensor = inputs;
     NODE_ASSERT(std::strcmp(imageTensor->name, TENSOR_NAME) == 0, "node input name is wrong");
     NODE_ASSERT(imageTensor->dimsCount == 4, "image tensor shape must have 4 dimensions")
-    NODE_ASSERT(imageTensor->dims[0] == 1, "image tensor must have batch size equal to 1")
+    NODE_ASSERT(imageTensor->precision == FP32 || imageTensor->precision == U8, "image tensor precision must be FP32 or U8");
+    const uint64_t batchSize = imageTensor->dims[0];
+    NODE_ASSERT(batchSize > 0, "image tensor batch size must be positive");
 
     uint64_t originalImageHeight = 0;
     uint64_t originalImageWidth = 0;
     uint64_t originalImageColorChannels = 0;
 
-    if (originalImageLayout == "NCHW") {
+    if (originalImageLayout == ImageLayout::NCHW) {
         originalImageColorChannels = imageTensor->dims[1];
         originalImageHeight = imageTensor->dims[2];
         originalImageWidth = imageTensor->dims[3];
-    } else if (originalImageLayout == "NHWC") {
+    } else {
         originalImageHeight = imageTensor->dims[1];
         originalImageWidth = imageTensor->dims[2];
         originalImageColorChannels = imageTensor->dims[3];
-    } else {
-        std::cout << "original image layout: " << originalImageLayout << " is unsupported" << std::endl;
-        return 1;
     }
 
     NODE_ASSERT(originalImageHeight > 0 && originalImageWidth > 0, "original image size must be positive");
     NODE_ASSERT(originalImageColorChannels == 1 || originalImageColorChannels == 3, "original image color channels must be 1 or 3");
-    NODE_ASSERT(originalImageHeight * originalImageWidth * originalImageColorChannels * sizeof(float) == imageTensor->dataBytes, "number of input bytes does not match input shape");
+    NODE_ASSERT(batchSize * originalImageHeight * originalImageWidth * originalImageColorChannels * image_precision_size(imageTensor->precision) == imageTensor->dataBytes, "number of input bytes does not match input shape");
 
-    if (originalImageColorOrder == "GRAY") {
+    if (originalImageColorOrder == ColorOrder::GRAY) {
         NODE_ASSERT(originalImageColorChannels == 1, "for color order GRAY color channels must be equal 1");
     }
-    if (originalImageColorOrder == "BGR" || originalImageColorOrder == "RGB") {
+    if (originalImageColorOrder == ColorOrder::BGR || originalImageColorOrder == ColorOrder::RGB) {
         NODE_ASSERT(originalImageColorChannels == 3, "for color order BGR/RGB color channels must be equal to 3");
     }
 
@@ -138,87 +142,63 @@ int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct Custo
     auto targetImageResolution = targetImageHeight * targetImageWidth;
 
     if (debugMode) {
-        std::cout << "Original image size: " << cv::Size2i(originalImageWidth, originalImageHeight) << std::endl;
-        std::cout << "Original image resolution: " << originalImageResolution << std::endl;
-        std::cout << "Original image color channels: " << originalImageColorChannels << std::endl;
-        std::cout << "Original image color order: " << originalImageColorOrder << std::endl;
-        std::cout << "Original image layout: " << originalImageLayout << std::endl;
-        std::cout << "Target image size: " << cv::Size2i(targetImageWidth, targetImageHeight) << std::endl;
-        std::cout << "Target image resolution: " << targetImageResolution << std::endl;
-        std::cout << "Target image color channels: " << targetImageColorChannels << std::endl;
-        std::cout << "Target image color order: " << targetImageColorOrder << std::endl;
-        std::cout << "Target image layout: " << targetImageLayout << std::endl;
-        std::cout << "Scale: " << (isScaleDefined ? std::to_string(scale) : "not defined") << std::endl;
-        std::cout << "Scale values: " << floatListToString(scaleValues) << std::endl;
-        std::cout << "Mean values: " << floatListToString(meanValues) << std::endl;
+        NODE_LOG_DEBUG("Original image size: " << cv::Size2i(originalImageWidth, originalImageHeight));
+        NODE_LOG_DEBUG("Original image resolution: " << originalImageResolution);
+        NODE_LOG_DEBUG("Original image color channels: " << originalImageColorChannels);
+        NODE_LOG_DEBUG("Original image color order: " << to_string(originalImageColorOrder));
+        NODE_LOG_DEBUG("Original image layout: " << to_string(originalImageLayout));
+        NODE_LOG_DEBUG("Target image size: " << cv::Size2i(targetImageWidth, targetImageHeight));
+        NODE_LOG_DEBUG("Target image resolution: " << targetImageResolution);
+        NODE_LOG_DEBUG("Target image color channels: " << targetImageColorChannels);
+        NODE_LOG_DEBUG("Target image color order: " << to_string(targetImageColorOrder));
+        NODE_LOG_DEBUG("Target image layout: " << to_string(targetImageLayout));
+        NODE_LOG_DEBUG("Scale: " << (isScaleDefined ? std::to_string(scale) : "not defined"));
+        NODE_LOG_DEBUG("Scale values: " << floatListToString(scaleValues));
+        NODE_LOG_DEBUG("Mean values: " << floatListToString(meanValues));
     }
     // ------------- validation end ---------------
 
-    // Prepare cv::Mat out of imageTensor input.
-    // In case input is in NCHW format, perform reordering to NHWC.
-    cv::Mat image = cv::Mat(originalImageHeight, originalImageWidth, originalImageColorChannels == 1 ? CV_32FC1 : CV_32FC3);
-    if (originalImageLayout == "NCHW") {
-        reorder_to_nhwc_2<float>((float*)imageTensor->data, (float*)image.data, originalImageHeight, originalImageWidth, originalImageColorChannels);
+    // Prepare output tensor
+    uint64_t targetImageSize = targetImageHeight * targetImageWidth * targetImageColorChannels;
+    uint64_t byteSize = sizeof(float) * batchSize * targetImageSize;
+    const bool nchw = targetImageLayout == ImageLayout::NCHW;
+    const uint64_t imageShape[4] = {batchSize, nchw ? targetImageColorChannels : targetImageHeight, nchw ? targetImageHeight : targetImageWidth, nchw ? targetImageWidth : targetImageColorChannels};
+    CustomNodeTensor* preallocatedImage = find_preallocated_output(preallocatedOutputs, preallocatedOutputsCount, TENSOR_NAME);
+    float* buffer = nullptr;
+    if (preallocatedImage != nullptr) {
+        NODE_ASSERT(prepare_preallocated_output(*preallocatedImage, byteSize, imageShape, 4, FP32), "preallocated image output is too small");
+        buffer = reinterpret_cast<float*>(preallocatedImage->data);
     } else {
-        std::memcpy(image.data, imageTensor->data, imageTensor->dataBytes);
-    }
-
-    // Change color order and number of channels.
-    static const std::map<std::pair<std::string, std::string>, int> colors = {
-        {{"GRAY", "BGR"}, cv::COLOR_GRAY2BGR},
-        {{"GRAY", "RGB"}, cv::COLOR_GRAY2RGB},
-        {{"BGR", "RGB"}, cv::COLOR_BGR2RGB},
-        {{"BGR", "GRAY"}, cv::COLOR_BGR2GRAY},
-        {{"RGB", "BGR"}, cv::COLOR_RGB2BGR},
-        {{"RGB", "GRAY"}, cv::COLOR_RGB2GRAY},
-    };
-
-    if (originalImageColorOrder != targetImageColorOrder) {
-        const auto& colorIt = colors.find({originalImageColorOrder, targetImageColorOrder});
-        NODE_ASSERT(colorIt != colors.end(), "unsupported color conversion");
-        cv::cvtColor(image, image, colorIt->second);
+        buffer = (float*)malloc(byteSize);
+        NODE_ASSERT(buffer != nullptr, "malloc has failed");
     }
 
-    // Perform procesesing with scale and mean values. If scale and scaleValues provided only scaleValues are used for scaling.
-    // If scale and meanValues provided mean values are subtracted from pixels first then scaling is made.
-    // Scaling will be applied before resize if target resolution is smaller.
-    if ((isScaleDefined || scaleValues.size() > 0 || meanValues.size() > 0) && originalImageResolution < targetImageResolution) {
-        if (debugMode) {
-            std::cout << "Performing scaling before resize operation" << std::endl;
+    // Images of batch are independent, each one is transformed by single thread.
+    uint64_t originalImageBytes = imageTensor->dataBytes / batchSize;
+    std::atomic<int> failures{0};
+    ovms::custom_nodes_common::parallel_for(batchSize, parameters->batchThreads, [&](size_t i) {
+        if (transform_image(imageTensor->data + i * originalImageBytes, imageTensor->precision, originalImageHeight, originalImageWidth, originalImageColorChannels,
+                targetImageHeight, targetImageWidth, *parameters, buffer + i * targetImageSize) != 0) {
+            failures++;
         }
-        NODE_ASSERT(scale_image(isScaleDefined, scale, meanValues, scaleValues, image), "Error during image scaling");
-    }
-
-    // Perform resize operation.
-    if (originalImageHeight != targetImageHeight || originalImageWidth != targetImageWidth) {
-        cv::resize(image, image, cv::Size(targetImageWidth, targetImageHeight));
-    }
-
-    // Scaling should be applied after resize if target resolution is smaller.
-    if ((isScaleDefined || scaleValues.size() > 0 || meanValues.size() > 0) && originalImageResolution >= targetImageResolution) {
-        if (debugMode) {
-            std::cout << "Performing scaling after resize operation" << std::endl;
+    });
+    if (failures > 0) {
+        if (preallocatedImage == nullptr) {
+            free(buffer);
         }
-        NODE_ASSERT(scale_image(isScaleDefined, scale, meanValues, scaleValues, image), "Error during image scaling");
+        return 1;
     }
-
-    // Prepare output tensor
-    uint64_t byteSize = sizeof(float) * targetImageHeight * targetImageWidth * targetImageColorChannels;
-    NODE_ASSERT(image.total() * image.elemSize() == byteSize, "buffer size differs");
-    float* buffer = (float*)malloc(byteSize);
-    NODE_ASSERT(buffer != nullptr, "malloc has failed");
-
-    if (targetImageLayout == "NCHW") {
-        reorder_to_nchw_2<float>((float*)image.data, (float*)buffer, image.rows, image.cols, image.channels());
-    } else {
-        std::memcpy((uint8_t*)buffer, image.data, byteSize);
+    if (preallocatedImage != nullptr) {
+        *outputs = nullptr;
+        *outputsCount = 0;
+        return 0;
     }
 
     *outputsCount = 1;
     *outputs = (struct CustomNodeTensor*)malloc(*outputsCount * sizeof(CustomNodeTensor));
 
     if ((*outputs) == nullptr) {
-        std::cout << "malloc has failed" << std::endl;
+        NODE_LOG_ERROR("malloc has failed");
         free(buffer);
         return 1;
     }
@@ -230,21 +210,34 @@ int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct Custo
     output.dimsCount = 4;
     output.dims = (uint64_t*)malloc(output.dimsCount * sizeof(uint64_t));
     NODE_ASSERT(output.dims != nullptr, "malloc has failed");
-    output.dims[0] = 1;
-    if (targetImageLayout == "NCHW") {
-        output.dims[1] = targetImageColorChannels;
-        output.dims[2] = targetImageHeight;
-        output.dims[3] = targetImageWidth;
-    } else {
-        output.dims[1] = targetImageHeight;
-        output.dims[2] = targetImageWidth;
-        output.dims[3] = targetImageColorChannels;
-    }
+    std::copy(imageShape, imageShape + 4, output.dims);
     output.precision = FP32;
     return 0;
 }
 
+int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    return processImages(inputs, inputsCount, nullptr, 0, outputs, outputsCount, customNodeLibraryInternalManager);
+}
+
+int executeInto(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor* preallocatedOutputs, int preallocatedOutputsCount,
+    struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    NODE_ASSERT(preallocated_outputs_supported(preallocatedOutputs, preallocatedOutputsCount, {TENSOR_NAME}), "only image output can be preallocated");
+    return processImages(inputs, inputsCount, preallocatedOutputs, preallocatedOutputsCount, outputs, outputsCount, customNodeLibraryInternalManager);
+}
+
+int executeAsync(const struct CustomNodeTensor* inputs, int inputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager,
+    CustomNodeCompletionCallback callback, void* userContext) {
+    return execute_async(execute, inputs, inputsCount, params, paramsCount, customNodeLibraryInternalManager, callback, userContext);
+}
+
+int getCapabilities(struct CustomNodeCapabilities* capabilities, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    return set_capabilities(capabilities, CUSTOM_NODE_CAPABILITY_EXECUTE_INTO | CUSTOM_NODE_CAPABILITY_EXECUTE_ASYNC);
+}
+
 int getInputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    ImagePreprocessingParameters parameters;
+    NODE_ASSERT(read_image_preprocessing_parameters(params, paramsCount, parameters) == 0, "node parameters are invalid");
+
     *infoCount = 1;
     *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
     NODE_ASSERT((*info) != nullptr, "malloc has failed");
@@ -253,11 +246,11 @@ int getInputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const stru
     (*info)[0].dimsCount = 4;
     (*info)[0].dims = (uint64_t*)malloc((*info)->dimsCount * sizeof(uint64_t));
     NODE_ASSERT(((*info)[0].dims) != nullptr, "malloc has failed");
-    (*info)[0].dims[0] = 1;
+    (*info)[0].dims[0] = parameters.maxBatchSize == 1 ? 1 : 0;
     (*info)[0].dims[1] = 0;
     (*info)[0].dims[2] = 0;
     (*info)[0].dims[3] = 0;
-    (*info)[0].precision = FP32;
+    (*info)[0].precision = parameters.originalImagePrecision;
     return 0;
 }
 
@@ -279,6 +272,8 @@ int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const str
     targetImageLayout = targetImageLayout.empty() ? originalImageLayout : targetImageLayout;
     NODE_ASSERT(originalImageLayout == "NCHW" || originalImageLayout == "NHWC", "original image layout must be NCHW or NHWC");
     NODE_ASSERT(targetImageLayout == "NCHW" || targetImageLayout == "NHWC", "target image layout must be NCHW or NHWC");
+    int maxBatchSize = get_int_parameter("max_batch_size", params, paramsCount, 1);
+    NODE_ASSERT(maxBatchSize > 0, "max batch size must be larger than 0");
 
     *infoCount = 1;
     *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
@@ -288,7 +283,7 @@ int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const str
     (*info)[0].dimsCount = 4;
     (*info)[0].dims = (uint64_t*)malloc((*info)->dimsCount * sizeof(uint64_t));
     NODE_ASSERT(((*info)[0].dims) != nullptr, "malloc has failed");
-    (*info)[0].dims[0] = 1;
+    (*info)[0].dims[0] = maxBatchSize == 1 ? 1 : 0;
 
     if (targetImageLayout == "NHWC") {
         (*info)[0].dims[1] = targetImageHeight == -1 ? 0 : targetImageHeight;
@@ -0,0 +1,124 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+// Standalone checks of grid based non maximum suppression against brute force greedy suppression.
+// Build and run from src/custom_nodes:
+//   g++ -std=c++17 -O2 -Icommon tests/nms_test.cpp common/nms.cpp -o nms_test && ./nms_test
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../common/nms.hpp"
+
+using ovms::custom_nodes_common::DetectionProposals;
+using ovms::custom_nodes_common::NmsMethod;
+using ovms::custom_nodes_common::NmsOptions;
+
+static int failures = 0;
+
+#define EXPECT(condition, message)                                   \
+    if (!(condition)) {                                              \
+        std::printf("FAILED %s:%d %s\n", __FILE__, __LINE__, message); \
+        failures++;                                                  \
+    }
+
+static float iou(const DetectionProposals& p, uint32_t a, uint32_t b) {
+    float interWidth = std::min(p.x[a] + p.width[a], p.x[b] + p.width[b]) - std::max(p.x[a], p.x[b]);
+    float interHeight = std::min(p.y[a] + p.height[a], p.y[b] + p.height[b]) - std::max(p.y[a], p.y[b]);
+    float inter = (interWidth > 0 && interHeight > 0) ? interWidth * interHeight : 0.0f;
+    float unionArea = p.width[a] * p.height[a] + p.width[b] * p.height[b] - inter;
+    return unionArea > 0 ? inter / unionArea : 0.0f;
+}
+
+// Reference greedy hard NMS comparing every pair of candidates.
+static std::vector<uint32_t> bruteForce(const DetectionProposals& p, const NmsOptions& options) {
+    std::vector<uint32_t> order(p.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return p.score[a] > p.score[b] || (p.score[a] == p.score[b] && a < b);
+    });
+    std::vector<uint32_t> picked;
+    for (uint32_t candidate : order) {
+        bool suppressed = false;
+        for (uint32_t kept : picked) {
+            if ((options.classAgnostic || p.classId[kept] == p.classId[candidate]) && iou(p, kept, candidate) > options.overlapThreshold) {
+                suppressed = true;
+                break;
+            }
+        }
+        if (!suppressed) {
+            picked.push_back(candidate);
+        }
+    }
+    return picked;
+}
+
+// Same box detected as two classes must be kept once per class.
+static void testLargeBoxOfTwoClasses() {
+    for (NmsMethod method : {NmsMethod::HARD, NmsMethod::LINEAR, NmsMethod::GAUSSIAN}) {
+        DetectionProposals proposals;
+        proposals.push(0, 0, 10, 10, 0.9f, 0);
+        proposals.push(0, 0, 10, 10, 0.8f, 1);
+        NmsOptions options;
+        options.method = method;
+        std::vector<uint32_t> picked;
+        std::vector<float> pickedScores;
+        ovms::custom_nodes_common::non_max_suppression(proposals, options, picked, pickedScores);
+        EXPECT(picked.size() == 2, "boxes of different classes suppressed each other");
+
+        options.classAgnostic = true;
+        ovms::custom_nodes_common::non_max_suppression(proposals, options, picked, pickedScores);
+        EXPECT(method != NmsMethod::HARD || picked.size() == 1, "class agnostic suppression kept overlapping box");
+    }
+}
+
+// Random proposals with boxes from tiny to spanning whole extent, compared with brute force.
+static void testRandomAgainstBruteForce() {
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> position(0.0f, 600.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int round = 0; round < 200; round++) {
+        DetectionProposals proposals;
+        const int count = 1 + round % 300;
+        const int classes = 1 + round % 5;
+        for (int i = 0; i < count; i++) {
+            float size = unit(generator) < 0.1f ? 600.0f * unit(generator) : 5.0f + 60.0f * unit(generator);
+            proposals.push(position(generator), position(generator), size, size * (0.5f + unit(generator)), unit(generator), (int)(generator() % classes));
+        }
+        for (bool classAgnostic : {false, true}) {
+            NmsOptions options;
+            options.overlapThreshold = 0.45f;
+            options.classAgnostic = classAgnostic;
+            std::vector<uint32_t> picked;
+            std::vector<float> pickedScores;
+            ovms::custom_nodes_common::non_max_suppression(proposals, options, picked, pickedScores);
+            EXPECT(picked == bruteForce(proposals, options), "grid suppression differs from brute force");
+        }
+    }
+}
+
+int main() {
+    testLargeBoxOfTwoClasses();
+    testRandomAgainstBruteForce();
+    if (failures > 0) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
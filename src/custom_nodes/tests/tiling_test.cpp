@@ -0,0 +1,99 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+// Standalone checks of tile grid computation, tile info validation and stitching regions.
+// Build and run from src/custom_nodes:
+//   g++ -std=c++17 -O2 -Icommon tests/tiling_test.cpp common/tiling.cpp -o tiling_test && ./tiling_test
+#include <cstdio>
+#include <vector>
+
+#include "../common/tiling.hpp"
+
+using ovms::custom_nodes_common::Tile;
+using ovms::custom_nodes_common::TILE_INFO_SIZE;
+
+static int failures = 0;
+
+#define EXPECT(condition, message)                                   \
+    if (!(condition)) {                                              \
+        std::printf("FAILED %s:%d %s\n", __FILE__, __LINE__, message); \
+        failures++;                                                  \
+    }
+
+// Tile info written for computed tiles is read back and owned regions cover every pixel once.
+static void testRoundTripAndCoverage() {
+    for (int rows : {100, 513, 1000, 1537}) {
+        for (int cols : {90, 513, 2000}) {
+            for (int overlap : {0, 64, 200}) {
+                std::vector<Tile> tiles = ovms::custom_nodes_common::compute_tiles(rows, cols, 513, 513, overlap);
+                std::vector<int32_t> info(tiles.size() * TILE_INFO_SIZE);
+                ovms::custom_nodes_common::write_tile_info(tiles, rows, cols, info.data());
+                std::vector<Tile> readTiles;
+                int readRows = 0;
+                int readCols = 0;
+                bool valid = ovms::custom_nodes_common::read_tile_info(info.data(), tiles.size(), readTiles, readRows, readCols);
+                EXPECT(valid && readRows == rows && readCols == cols, "written tile info rejected");
+                if (!valid) {
+                    continue;
+                }
+                std::vector<Tile> regions = ovms::custom_nodes_common::owned_regions(readTiles, rows, cols);
+                std::vector<int> coverage((size_t)rows * cols, 0);
+                for (const Tile& region : regions) {
+                    for (int y = region.y; y < region.y + region.height; y++) {
+                        for (int x = region.x; x < region.x + region.width; x++) {
+                            coverage[(size_t)y * cols + x]++;
+                        }
+                    }
+                }
+                bool coveredOnce = true;
+                for (int count : coverage) {
+                    coveredOnce = coveredOnce && count == 1;
+                }
+                EXPECT(coveredOnce, "owned regions do not cover image exactly once");
+            }
+        }
+    }
+}
+
+// Grids with gaps or with duplicated tile in place of missing one are rejected.
+static void testInvalidGridsRejected() {
+    std::vector<Tile> tiles;
+    int rows = 0;
+    int cols = 0;
+    std::vector<int32_t> gap = {
+        0, 0, 10, 10, 10, 30,
+        0, 20, 10, 10, 10, 30};
+    EXPECT(!ovms::custom_nodes_common::read_tile_info(gap.data(), 2, tiles, rows, cols), "grid with gap accepted");
+    std::vector<int32_t> duplicate = {
+        0, 0, 10, 10, 15, 15,
+        0, 5, 10, 10, 15, 15,
+        5, 0, 10, 10, 15, 15,
+        0, 0, 10, 10, 15, 15};
+    EXPECT(!ovms::custom_nodes_common::read_tile_info(duplicate.data(), 4, tiles, rows, cols), "grid with duplicated tile accepted");
+    duplicate[18] = 5;
+    duplicate[19] = 5;
+    EXPECT(ovms::custom_nodes_common::read_tile_info(duplicate.data(), 4, tiles, rows, cols), "complete grid rejected");
+}
+
+int main() {
+    testRoundTripAndCoverage();
+    testInvalidGridsRejected();
+    if (failures > 0) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -13,21 +13,74 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //*****************************************************************************
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <shared_mutex>
 #include <string>
+#include <vector>
 
 #include "../../custom_node_interface.h"
+#include "../common/async_executor_utils.hpp"
+#include "../common/buffersqueue_utils.hpp"
+#include "../common/custom_node_library_internal_manager.hpp"
+#include "../common/detections.hpp"
+#include "../common/nms.hpp"
 #include "../common/opencv_utils.hpp"
+#include "../common/parallel.hpp"
+#include "../common/tiling.hpp"
 #include "../common/utils.hpp"
 #include "opencv2/opencv.hpp"
 
-static constexpr const char* TENSOR_NAME = "image";
+using CustomNodeLibraryInternalManager = ovms::custom_nodes_common::CustomNodeLibraryInternalManager;
+using DetectionProposals = ovms::custom_nodes_common::DetectionProposals;
+using NmsOptions = ovms::custom_nodes_common::NmsOptions;
+using Tile = ovms::custom_nodes_common::Tile;
+using ovms::custom_nodes_common::TILE_INFO_SIZE;
+using ovms::custom_nodes_common::find_max;
+using ovms::custom_nodes_common::non_max_suppression;
+using ovms::custom_nodes_common::parse_nms_method;
+using ovms::custom_nodes_common::parse_nms_overlap;
+using ovms::custom_nodes_common::select_rows_above;
 
-struct Object {
-    cv::Rect_<float> box;
-    float score;
-    int class_id;
+static constexpr const char* TENSOR_NAME = "image";
+// ratio, original image height, original image width, produced by yolox_preprocessing
+static constexpr const char* LETTERBOX_INFO_TENSOR_NAME = "letterbox_info";
+static constexpr int LETTERBOX_INFO_SIZE = 3;
+// position of each tile and size of original image, produced by yolox_preprocessing in tiling mode
+static constexpr const char* TILE_INFO_TENSOR_NAME = "tile_info";
+// smaller anchor ranges are decoded by single thread
+static constexpr size_t MIN_ANCHORS_PER_BAND = 2048;
+
+static constexpr const char* OUTPUT_TENSOR_NAME = "output_tensor";
+static constexpr const char* OUTPUT_DETECTIONS_NAME = "output_detections";
+static constexpr const char* OUTPUT_DETECTIONS_DIMS_NAME = "output_detections_dims";
+
+static constexpr int DETECTION_DEPTH = 6;  // id, score, x, y, w, h
+
+// Compact output format: fixed size tensors padded up to max_detections
+static constexpr const char* NUM_DETECTIONS_TENSOR_NAME = "num_detections";
+static constexpr const char* DETECTION_BOXES_TENSOR_NAME = "detection_boxes";
+static constexpr const char* DETECTION_SCORES_TENSOR_NAME = "detection_scores";
+static constexpr const char* DETECTION_CLASSES_TENSOR_NAME = "detection_classes";
+
+static constexpr const char* OUTPUT_NUM_DETECTIONS_NAME = "output_num_detections";
+static constexpr const char* OUTPUT_DETECTION_BOXES_NAME = "output_detection_boxes";
+static constexpr const char* OUTPUT_DETECTION_SCORES_NAME = "output_detection_scores";
+static constexpr const char* OUTPUT_DETECTION_CLASSES_NAME = "output_detection_classes";
+static constexpr const char* OUTPUT_COMPACT_DIMS_NAME = "output_compact_dims";
+
+static constexpr int COMPACT_OUTPUTS_COUNT = 4;
+static constexpr int BOX_DEPTH = 4;  // x0, y0, x1, y1
+
+enum class OutputFormat {
+    LEGACY,   // count x [id, score * 100, x, y, w, h] float tensor
+    COMPACT   // num_detections, detection_boxes, detection_scores, detection_classes
 };
 
 struct GridAndStride
@@ -37,132 +90,551 @@ struct GridAndStride
     int stride;
 };
 
-static inline float intersection_area(const Object& a, const Object& b)
-{
-    cv::Rect_<float> inter = a.box & b.box;
-    return inter.area();
+// Parameters parsed and validated once in initialize()
+struct YoloxPostprocessingParameters {
+    int sourceImageHeight;
+    int sourceImageWidth;
+    int numClass;
+    float nmsThresh;
+    float bboxConfThresh;
+    int maxDetections;
+    OutputFormat outputFormat;
+    // FP32 or FP16 encoding of detection_boxes in compact format
+    CustomNodeTensorPrecision boxPrecision;
+    NmsOptions nmsOptions;
+    // when false only best scoring class of each anchor is proposed
+    bool multiLabel;
+    // images in batch above this size are still processed, but their buffers are not preallocated
+    int maxBatchSize;
+    int batchThreads;
+    // boxes are mapped to original image given by letterbox_info input, otherwise they stay in model input coordinates
+    bool rescaleBoxes;
+    // batch holds tiles of single image, their detections are merged into detections of that image
+    bool tiling;
+    bool debugMode;
+    // anchor grid positions and strides in model output order, depends only on input size and strides
+    std::vector<int> strides;
+    std::vector<GridAndStride> gridStrides;
+};
+
+// yolox/models/yolo_head.py get_output_and_grid, anchors of each stride level follow previous level in row major order
+static void generateGridsAndStrides(int sourceImageHeight, int sourceImageWidth, const std::vector<int>& strides, std::vector<GridAndStride>& gridStrides) {
+    size_t anchorsCount = 0;
+    for (auto stride : strides) {
+        anchorsCount += (size_t)(sourceImageHeight / stride) * (sourceImageWidth / stride);
+    }
+    gridStrides.clear();
+    gridStrides.reserve(anchorsCount);
+    for (auto stride : strides) {
+        int num_grid_w = sourceImageWidth / stride;
+        int num_grid_h = sourceImageHeight / stride;
+        for (int g1 = 0; g1 < num_grid_h; g1++) {
+            for (int g0 = 0; g0 < num_grid_w; g0++) {
+                gridStrides.push_back(GridAndStride{g0, g1, stride});
+            }
+        }
+    }
 }
 
-static void qsort_descent_inplace(std::vector<Object>& faceobjects, int left, int right)
-{
-    int i = left;
-    int j = right;
-    float p = faceobjects[(left + right) / 2].score;
+static int readParameters(const struct CustomNodeParam* params, int paramsCount, YoloxPostprocessingParameters& parameters) {
+    parameters.sourceImageHeight = get_int_parameter("input_h", params, paramsCount, -1);
+    parameters.sourceImageWidth = get_int_parameter("input_w", params, paramsCount, -1);
+    NODE_ASSERT(parameters.sourceImageHeight > 0, "Source image height - must be larger than 0");
+    NODE_ASSERT(parameters.sourceImageWidth > 0, "Source image width - must be larger than 0");
+
+    parameters.numClass = get_int_parameter("num_class", params, paramsCount, -1);
+    NODE_ASSERT(parameters.numClass > 0, "Number of class - must be larger than 0");
+
+    parameters.nmsThresh = get_float_parameter("nms_thresh", params, paramsCount, -1);
+    NODE_ASSERT(parameters.nmsThresh > 0 && parameters.nmsThresh <= 1, "NMS Threshold is between 0 and 1");
+
+    parameters.bboxConfThresh = get_float_parameter("bbox_conf_thresh", params, paramsCount, -1);
+    NODE_ASSERT(parameters.bboxConfThresh > 0 && parameters.bboxConfThresh <= 1, "BBOX Confidence Threshold is between 0 and 1");
+
+    parameters.maxDetections = get_int_parameter("max_detections", params, paramsCount, 100);
+    NODE_ASSERT(parameters.maxDetections > 0, "max detections must be larger than 0");
+
+    // Suppression variant: nms_method hard (default), linear or gaussian (Soft-NMS), nms_overlap iou (default) or diou.
+    // Boxes of different classes do not suppress each other unless class_agnostic_nms is true.
+    NmsOptions& nmsOptions = parameters.nmsOptions;
+    NODE_ASSERT(parse_nms_method(get_string_parameter("nms_method", params, paramsCount, "hard"), nmsOptions.method), "nms method must be hard, linear or gaussian");
+    NODE_ASSERT(parse_nms_overlap(get_string_parameter("nms_overlap", params, paramsCount, "iou"), nmsOptions.overlap), "nms overlap must be iou or diou");
+    nmsOptions.overlapThreshold = parameters.nmsThresh;
+    nmsOptions.scoreThreshold = parameters.bboxConfThresh;
+    nmsOptions.sigma = get_float_parameter("soft_nms_sigma", params, paramsCount, 0.5f);
+    NODE_ASSERT(nmsOptions.sigma > 0, "soft nms sigma must be larger than 0");
+    nmsOptions.topK = get_int_parameter("nms_top_k", params, paramsCount, 0);
+    NODE_ASSERT(nmsOptions.topK >= 0, "nms top k must not be negative");
+    nmsOptions.classAgnostic = get_string_parameter("class_agnostic_nms", params, paramsCount, "false") == "true";
+
+    // output_format legacy (default) or compact, box_precision FP32 (default) or FP16 for compact format
+    std::string outputFormat = get_string_parameter("output_format", params, paramsCount, "legacy");
+    NODE_ASSERT(outputFormat == "legacy" || outputFormat == "compact", "output format must be legacy or compact");
+    parameters.outputFormat = outputFormat == "compact" ? OutputFormat::COMPACT : OutputFormat::LEGACY;
+    std::string boxPrecision = get_string_parameter("box_precision", params, paramsCount, "FP32");
+    NODE_ASSERT(boxPrecision == "FP32" || boxPrecision == "FP16", "box precision must be FP32 or FP16");
+    parameters.boxPrecision = boxPrecision == "FP16" ? FP16 : FP32;
+    // compact outputs hold at most max_detections boxes, so selection can stop there
+    if (parameters.outputFormat == OutputFormat::COMPACT) {
+        nmsOptions.maxOutputs = parameters.maxDetections;
+    }
 
-    while (i <= j)
-    {
-        while (faceobjects[i].score > p)
-            i++;
+    parameters.multiLabel = get_string_parameter("multi_label", params, paramsCount, "true") == "true";
+
+    // Strides of detection head levels, [8,16,32] for standard models, [8,16,32,64] for P6 variants.
+    parameters.strides = get_int_list_parameter("strides", params, paramsCount);
+    if (parameters.strides.empty()) {
+        parameters.strides = {8, 16, 32};
+    }
+    for (auto stride : parameters.strides) {
+        NODE_ASSERT(stride > 0, "strides must be larger than 0");
+        NODE_ASSERT(stride <= parameters.sourceImageHeight && stride <= parameters.sourceImageWidth, "strides must not be larger than source image size");
+    }
+    generateGridsAndStrides(parameters.sourceImageHeight, parameters.sourceImageWidth, parameters.strides, parameters.gridStrides);
+
+    parameters.maxBatchSize = get_int_parameter("max_batch_size", params, paramsCount, 1);
+    NODE_ASSERT(parameters.maxBatchSize > 0, "max batch size must be larger than 0");
+    parameters.batchThreads = get_int_parameter("batch_threads", params, paramsCount, ovms::custom_nodes_common::default_thread_count());
+    NODE_ASSERT(parameters.batchThreads > 0, "batch threads must be larger than 0");
+    parameters.tiling = get_string_parameter("tiling", params, paramsCount, "false") == "true";
+    // letterbox_info input is declared only with rescaling, so pipelines without it stay valid
+    parameters.rescaleBoxes = get_string_parameter("rescale_boxes", params, paramsCount, "false") == "true";
+    NODE_ASSERT(!parameters.rescaleBoxes || !parameters.tiling, "rescale boxes - tiling mode maps boxes with tile_info instead");
+
+    // Debug flag for additional logging.
+    parameters.debugMode = get_string_parameter("debug", params, paramsCount) == "true";
+    return 0;
+}
 
-        while (faceobjects[j].score < p)
-            j--;
+static int initializeBuffersQueues(CustomNodeLibraryInternalManager* internalManager, const YoloxPostprocessingParameters& parameters, const struct CustomNodeParam* params, int paramsCount) {
+    // reading parameters to determine BuffersQueues sizes
+    int queueSize = get_int_parameter("buffer_queue_size", params, paramsCount, 24);
+    NODE_ASSERT(queueSize > 0, "buffer queue size must be larger than 0");
+    auto buffersQueueOptions = get_buffers_queue_options(params, paramsCount, queueSize);
+    // huge pages and NUMA binding are meant for large data buffers, small metadata pools keep default options
+    const ovms::custom_nodes_common::BuffersQueueOptions metadataBuffersQueueOptions{};
+    // tiles of batch are merged into single image
+    const uint64_t outputBatchSize = parameters.tiling ? 1 : parameters.maxBatchSize;
+
+    if (parameters.outputFormat == OutputFormat::COMPACT) {
+        // creating BuffersQueues for compact outputs, all of them have fixed size
+        uint64_t boxElementSize = parameters.boxPrecision == FP16 ? sizeof(uint16_t) : sizeof(float);
+        uint64_t slots = outputBatchSize * parameters.maxDetections;
+        NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_NUM_DETECTIONS_NAME, sizeof(int32_t) * outputBatchSize, queueSize, metadataBuffersQueueOptions), "output num detections buffer creation failed");
+        NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_DETECTION_BOXES_NAME, boxElementSize * slots * BOX_DEPTH, queueSize, buffersQueueOptions), "output detection boxes buffer creation failed");
+        NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_DETECTION_SCORES_NAME, sizeof(float) * slots, queueSize, buffersQueueOptions), "output detection scores buffer creation failed");
+        NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_DETECTION_CLASSES_NAME, sizeof(int32_t) * slots, queueSize, buffersQueueOptions), "output detection classes buffer creation failed");
+        NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_COMPACT_DIMS_NAME, 3 * sizeof(uint64_t), COMPACT_OUTPUTS_COUNT * queueSize, metadataBuffersQueueOptions), "output compact dims buffer creation failed");
+        NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_TENSOR_NAME, COMPACT_OUTPUTS_COUNT * sizeof(CustomNodeTensor), queueSize, metadataBuffersQueueOptions), "output tensor buffer creation failed");
+        return 0;
+    }
 
-        if (i <= j)
-        {
-            // swap
-            std::swap(faceobjects[i], faceobjects[j]);
+    // creating BuffersQueues for output: detections
+    // results with more detections than max_detections are allocated on heap
+    uint64_t detectionsByteSize = sizeof(float) * outputBatchSize * parameters.maxDetections * DETECTION_DEPTH;
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_DETECTIONS_NAME, detectionsByteSize, queueSize, buffersQueueOptions), "output detections buffer creation failed");
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_DETECTIONS_DIMS_NAME, 3 * sizeof(uint64_t), queueSize, metadataBuffersQueueOptions), "output detections dims buffer creation failed");
+    NODE_ASSERT(internalManager->recreateBuffersQueue(OUTPUT_TENSOR_NAME, 1 * sizeof(CustomNodeTensor), queueSize, metadataBuffersQueueOptions), "output tensor buffer creation failed");
+    return 0;
+}
 
-            i++;
-            j--;
+static int initializeParametersAndBuffersQueues(CustomNodeLibraryInternalManager* internalManager, const struct CustomNodeParam* params, int paramsCount) {
+    // parameters are parsed once here, execute() only reads them
+    // messages of initialization are filtered by settings of initialized node
+    ovms::custom_nodes_common::LogSettings::Scope logScope(internalManager->getLogSettings());
+    NODE_ASSERT(configure_logger(internalManager->getLogSettings(), params, paramsCount) == 0, "logger configuration failed");
+    NODE_ASSERT(configure_thread_pool(params, paramsCount) == 0, "thread pool configuration failed");
+    std::unique_ptr<YoloxPostprocessingParameters> parameters = std::make_unique<YoloxPostprocessingParameters>();
+    NODE_ASSERT(readParameters(params, paramsCount, *parameters) == 0, "node parameters are invalid");
+    NODE_ASSERT(initializeBuffersQueues(internalManager, *parameters, params, paramsCount) == 0, "buffers queues creation failed");
+    internalManager->setParameters(std::move(parameters));
+    return 0;
+}
+
+static int initializeInternalManager(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    // creating InternalManager instance
+    std::unique_ptr<CustomNodeLibraryInternalManager> internalManager = std::make_unique<CustomNodeLibraryInternalManager>();
+    NODE_ASSERT(internalManager != nullptr, "internalManager allocation failed");
+    NODE_ASSERT(initializeParametersAndBuffersQueues(internalManager.get(), params, paramsCount) == 0, "internalManager initialization failed");
+    create_async_executor(internalManager.get(), params, paramsCount);
+    *customNodeLibraryInternalManager = internalManager.release();
+    return 0;
+}
+
+static int reinitializeInternalManagerIfNecessary(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(*customNodeLibraryInternalManager);
+    // executions are blocked while parameters and queues are replaced, buffers still in flight are returned to replaced queues
+    std::unique_lock<std::shared_timed_mutex> lock(internalManager->getInternalManagerLock());
+    NODE_ASSERT(initializeParametersAndBuffersQueues(internalManager, params, paramsCount) == 0, "internalManager reinitialization failed");
+    return 0;
+}
+
+// Selected detections of single image in original image coordinates, boxes as x0, y0, x1, y1
+struct ImageDetections {
+    std::vector<int32_t> classIds;
+    std::vector<float> scores;
+    std::vector<float> boxes;
+};
+
+// Writes [batch, count, 6] tensor, count is the largest number of detections in batch and images with less detections are padded with class -1 and score 0.
+static int writeLegacyOutputs(CustomNodeLibraryInternalManager* internalManager, const std::vector<ImageDetections>& results, uint64_t batchSize, struct CustomNodeTensor** outputs, int* outputsCount) {
+    uint64_t count = 0;
+    for (uint64_t b = 0; b < batchSize; b++) {
+        count = std::max<uint64_t>(count, results[b].classIds.size());
+    }
+    uint64_t byteSize = sizeof(float) * batchSize * count * DETECTION_DEPTH;
+    float* buffer = nullptr;
+    NODE_ASSERT(get_buffer<float>(internalManager, &buffer, OUTPUT_DETECTIONS_NAME, byteSize), "buffer acquire failed");
+    for (uint64_t b = 0; b < batchSize; b++) {
+        const ImageDetections& result = results[b];
+        const uint64_t imageCount = result.classIds.size();
+        float* imageBuffer = buffer + b * count * DETECTION_DEPTH;
+        for (uint64_t i = 0; i < imageCount; i++) {
+            const float* box = result.boxes.data() + i * BOX_DEPTH;
+            float* detection = imageBuffer + i * DETECTION_DEPTH;
+            detection[0] = result.classIds[i];
+            detection[1] = result.scores[i] * 100;
+            detection[2] = box[0];
+            detection[3] = box[1];
+            detection[4] = box[2] - box[0];
+            detection[5] = box[3] - box[1];
+        }
+        for (uint64_t i = imageCount; i < count; i++) {
+            float* detection = imageBuffer + i * DETECTION_DEPTH;
+            std::fill(detection, detection + DETECTION_DEPTH, 0.0f);
+            detection[0] = -1;
         }
     }
 
-    #pragma omp parallel sections
-    {
-        #pragma omp section
-        {
-            if (left < j) qsort_descent_inplace(faceobjects, left, j);
+    *outputsCount = 1;
+    if (!get_buffer<struct CustomNodeTensor>(internalManager, outputs, OUTPUT_TENSOR_NAME, *outputsCount * sizeof(CustomNodeTensor))) {
+        release(buffer, internalManager);
+        return 1;
+    }
+
+    CustomNodeTensor& output = (*outputs)[0];
+    output.name = TENSOR_NAME;
+    output.data = reinterpret_cast<uint8_t*>(buffer);
+    output.dataBytes = byteSize;
+    output.dimsCount = 3;
+    if (!get_buffer<uint64_t>(internalManager, &(output.dims), OUTPUT_DETECTIONS_DIMS_NAME, output.dimsCount * sizeof(uint64_t))) {
+        release(buffer, internalManager);
+        release(*outputs, internalManager);
+        return 1;
+    }
+    output.dims[0] = batchSize;
+    output.dims[1] = count;
+    output.dims[2] = DETECTION_DEPTH;
+    output.precision = FP32;
+    return 0;
+}
+
+static void setCompactOutput(CustomNodeTensor& output, const char* name, void* data, uint64_t dataBytes, uint64_t* dims, std::initializer_list<uint64_t> shape, CustomNodeTensorPrecision precision) {
+    output.name = name;
+    output.data = reinterpret_cast<uint8_t*>(data);
+    output.dataBytes = dataBytes;
+    output.dims = dims;
+    output.dimsCount = shape.size();
+    std::copy(shape.begin(), shape.end(), dims);
+    output.precision = precision;
+}
+
+// Writes fixed size outputs with max_detections slots per image, slots after num_detections have class -1, score 0 and empty box.
+static int writeCompactOutputs(CustomNodeLibraryInternalManager* internalManager, const YoloxPostprocessingParameters& parameters, const std::vector<ImageDetections>& results, uint64_t batchSize, struct CustomNodeTensor** outputs, int* outputsCount) {
+    const uint64_t maxDetections = parameters.maxDetections;
+    const uint64_t slots = batchSize * maxDetections;
+    const uint64_t boxElementSize = parameters.boxPrecision == FP16 ? sizeof(uint16_t) : sizeof(float);
+
+    int32_t* numDetectionsBuffer = nullptr;
+    uint8_t* boxesBuffer = nullptr;
+    float* scoresBuffer = nullptr;
+    int32_t* classesBuffer = nullptr;
+    uint64_t* dims[COMPACT_OUTPUTS_COUNT] = {nullptr, nullptr, nullptr, nullptr};
+    bool acquired = get_buffer<int32_t>(internalManager, &numDetectionsBuffer, OUTPUT_NUM_DETECTIONS_NAME, sizeof(int32_t) * batchSize) &&
+                    get_buffer<uint8_t>(internalManager, &boxesBuffer, OUTPUT_DETECTION_BOXES_NAME, boxElementSize * slots * BOX_DEPTH) &&
+                    get_buffer<float>(internalManager, &scoresBuffer, OUTPUT_DETECTION_SCORES_NAME, sizeof(float) * slots) &&
+                    get_buffer<int32_t>(internalManager, &classesBuffer, OUTPUT_DETECTION_CLASSES_NAME, sizeof(int32_t) * slots);
+    for (int i = 0; acquired && i < COMPACT_OUTPUTS_COUNT; i++) {
+        acquired = get_buffer<uint64_t>(internalManager, &dims[i], OUTPUT_COMPACT_DIMS_NAME, 3 * sizeof(uint64_t));
+    }
+    acquired = acquired && get_buffer<struct CustomNodeTensor>(internalManager, outputs, OUTPUT_TENSOR_NAME, COMPACT_OUTPUTS_COUNT * sizeof(CustomNodeTensor));
+    if (!acquired) {
+        void* buffers[] = {numDetectionsBuffer, boxesBuffer, scoresBuffer, classesBuffer, dims[0], dims[1], dims[2], dims[3]};
+        for (void* buffer : buffers) {
+            if (buffer != nullptr) {
+                release(buffer, internalManager);
+            }
         }
-        #pragma omp section
-        {
-            if (i < right) qsort_descent_inplace(faceobjects, i, right);
+        NODE_ASSERT(false, "buffer acquire failed");
+    }
+
+    for (uint64_t b = 0; b < batchSize; b++) {
+        const ImageDetections& result = results[b];
+        const uint64_t count = std::min<uint64_t>(result.classIds.size(), maxDetections);
+        int32_t* classes = classesBuffer + b * maxDetections;
+        float* scores = scoresBuffer + b * maxDetections;
+        uint8_t* boxes = boxesBuffer + boxElementSize * b * maxDetections * BOX_DEPTH;
+        numDetectionsBuffer[b] = count;
+        std::copy(result.classIds.begin(), result.classIds.begin() + count, classes);
+        std::fill(classes + count, classes + maxDetections, -1);
+        std::copy(result.scores.begin(), result.scores.begin() + count, scores);
+        std::fill(scores + count, scores + maxDetections, 0.0f);
+        if (parameters.boxPrecision == FP16) {
+            uint16_t* boxesHalf = reinterpret_cast<uint16_t*>(boxes);
+            for (uint64_t i = 0; i < count * BOX_DEPTH; i++) {
+                boxesHalf[i] = float_to_half(result.boxes[i]);
+            }
+        } else {
+            std::memcpy(boxes, result.boxes.data(), sizeof(float) * count * BOX_DEPTH);
         }
+        std::memset(boxes + boxElementSize * count * BOX_DEPTH, 0, boxElementSize * (maxDetections - count) * BOX_DEPTH);
     }
+
+    *outputsCount = COMPACT_OUTPUTS_COUNT;
+    setCompactOutput((*outputs)[0], NUM_DETECTIONS_TENSOR_NAME, numDetectionsBuffer, sizeof(int32_t) * batchSize, dims[0], {batchSize, 1}, I32);
+    setCompactOutput((*outputs)[1], DETECTION_BOXES_TENSOR_NAME, boxesBuffer, boxElementSize * slots * BOX_DEPTH, dims[1], {batchSize, maxDetections, BOX_DEPTH}, parameters.boxPrecision);
+    setCompactOutput((*outputs)[2], DETECTION_SCORES_TENSOR_NAME, scoresBuffer, sizeof(float) * slots, dims[2], {batchSize, maxDetections}, FP32);
+    setCompactOutput((*outputs)[3], DETECTION_CLASSES_TENSOR_NAME, classesBuffer, sizeof(int32_t) * slots, dims[3], {batchSize, maxDetections}, I32);
+    return 0;
 }
 
-static void qsort_descent_inplace(std::vector<Object>& objects)
-{
-    if (objects.empty())
-        return;
+// Decodes proposals of single image with score above confidence threshold, boxes are in model input coordinates.
+static void decodeProposals(const float* output_buffer, const YoloxPostprocessingParameters& parameters, DetectionProposals& detections) {
+    const int _numClass = parameters.numClass;
+    const float _bboxConfThresh = parameters.bboxConfThresh;
 
-    qsort_descent_inplace(objects, 0, objects.size() - 1);
+    // net_pred -> output_buffer
+    // decode_output (pred, objects, scale, img_w, img_h)
+    const std::vector<GridAndStride>& grid_strides = parameters.gridStrides;
+
+    // generate_yolox_proposals(grid_stirdes, pred, BBOX_CONF_THRESH, proposals)
+    const int num_anchors = grid_strides.size();
+    const int num_attributes = _numClass + 5;
+
+    // Scratch storage reused by executions on the same thread, sized for all anchors.
+    static thread_local std::vector<uint32_t> candidates;
+    static thread_local std::vector<DetectionProposals> bandDetections;
+    const size_t bandsCount = std::max<size_t>((num_anchors + MIN_ANCHORS_PER_BAND - 1) / MIN_ANCHORS_PER_BAND, 1);
+    candidates.resize(num_anchors);
+    if (bandDetections.size() < bandsCount) {
+        bandDetections.resize(bandsCount);
+    }
+    detections.clear();
+    // Thread local storage of calling thread is used by pool threads decoding bands.
+    uint32_t* anchorCandidates = candidates.data();
+    std::vector<DetectionProposals>& bands = bandDetections;
+
+    // Anchors are decoded in bands by shared thread pool. Proposals of each band are kept separately
+    // and joined in anchor order, so results do not depend on number of threads.
+    ovms::custom_nodes_common::parallel_for(bandsCount, ovms::custom_nodes_common::POOL_THREADS, [&](size_t band) {
+        const size_t begin = (size_t)num_anchors * band / bandsCount;
+        const size_t end = (size_t)num_anchors * (band + 1) / bandsCount;
+        DetectionProposals& proposals = bands[band];
+        proposals.clear();
+
+        // Class scores are sigmoid outputs not larger than 1, so box_objectness * box_cls_score cannot
+        // exceed threshold for anchors with objectness at or below it. Those are rejected before touching class rows.
+        uint32_t* selected = anchorCandidates + begin;
+        const size_t num_candidates = select_rows_above(output_buffer + begin * num_attributes, end - begin, num_attributes, 4, _bboxConfThresh, selected);
+
+        for (size_t candidate_idx = 0; candidate_idx < num_candidates; candidate_idx++)
+        {
+            const int anchor_idx = begin + selected[candidate_idx];
+            const float* pred = output_buffer + (size_t)anchor_idx * num_attributes;
+
+            const float box_objectness = pred[4];
+            int best_class = 0;
+            const float best_cls_score = find_max(pred + 5, _numClass, &best_class);
+            if (!(box_objectness * best_cls_score > _bboxConfThresh))
+                continue;
+
+            const int grid0 = grid_strides[anchor_idx].grid0;
+            const int grid1 = grid_strides[anchor_idx].grid1;
+            const int stride = grid_strides[anchor_idx].stride;
+
+            // yolox/models/yolo_head.py decode logic
+            //  outputs[..., :2] = (outputs[..., :2] + grids) * strides
+            //  outputs[..., 2:4] = torch.exp(outputs[..., 2:4]) * strides
+            float x_center = (pred[0] + grid0) * stride;
+            float y_center = (pred[1] + grid1) * stride;
+            float w = std::exp(pred[2]) * stride;
+            float h = std::exp(pred[3]) * stride;
+            float x0 = x_center - w * 0.5f;
+            float y0 = y_center - h * 0.5f;
+
+            if (!parameters.multiLabel) {
+                proposals.push(x0, y0, w, h, box_objectness * best_cls_score, best_class);
+                continue;
+            }
+            for (int class_idx = 0; class_idx < _numClass; class_idx++)
+            {
+                float box_prob = box_objectness * pred[5 + class_idx];
+                if (box_prob > _bboxConfThresh)
+                    proposals.push(x0, y0, w, h, box_prob, class_idx);
+            } // class loop
+
+        } // point anchor loop
+    });
+    for (size_t band = 0; band < bandsCount; band++) {
+        detections.append(bands[band]);
+    }
 }
 
-static void nms_sorted_bboxes(const std::vector<Object>& faceobjects, std::vector<int>& picked, float nms_threshold)
-{
-    picked.clear();
+// Suppresses overlapping proposals and writes selected boxes divided by scale and clipped to clipWidth x clipHeight image.
+static void selectDetections(const DetectionProposals& detections, float scale, float clipWidth, float clipHeight, const YoloxPostprocessingParameters& parameters, ImageDetections& result) {
+    const bool debugMode = parameters.debugMode;
+    NODE_LOG_DEBUG("NUM OBJECTS : " << detections.size());
 
-    const int n = faceobjects.size();
+    static thread_local std::vector<uint32_t> picked;
+    static thread_local std::vector<float> pickedScores;
+    non_max_suppression(detections, parameters.nmsOptions, picked, pickedScores);
+    int count = picked.size();
 
-    std::vector<float> areas(n);
-    for (int i = 0; i < n; i++)
-    {
-        areas[i] = faceobjects[i].box.area();
-    }
+    NODE_LOG_DEBUG("NMS RESULT OBJECTS : " << count);
 
-    for (int i = 0; i < n; i++)
+    std::vector<int32_t>& classIds = result.classIds;
+    std::vector<float>& scores = result.scores;
+    std::vector<float>& boxes = result.boxes;
+    classIds.resize(count);
+    scores.resize(count);
+    boxes.resize(count * BOX_DEPTH);
+    for (int i = 0; i < count; i++)
     {
-        const Object& a = faceobjects[i];
+        const uint32_t proposal = picked[i];
 
-        int keep = 1;
-        for (int j = 0; j < (int)picked.size(); j++)
-        {
-            const Object& b = faceobjects[picked[j]];
-
-            // intersection over union
-            float inter_area = intersection_area(a, b);
-            float union_area = areas[i] + areas[picked[j]] - inter_area;
-            // float IoU = inter_area / union_area
-            if (inter_area / union_area > nms_threshold)
-                keep = 0;
+        // adjust offset to original unpadded
+        float x0 = (detections.x[proposal]) / scale;
+        float y0 = (detections.y[proposal]) / scale;
+        float x1 = (detections.x[proposal] + detections.width[proposal]) / scale;
+        float y1 = (detections.y[proposal] + detections.height[proposal]) / scale;
+
+        // clip
+        float* box = boxes.data() + i * BOX_DEPTH;
+        box[0] = std::max(std::min(x0, clipWidth - 1), 0.f);
+        box[1] = std::max(std::min(y0, clipHeight - 1), 0.f);
+        box[2] = std::max(std::min(x1, clipWidth - 1), 0.f);
+        box[3] = std::max(std::min(y1, clipHeight - 1), 0.f);
+        classIds[i] = detections.classId[proposal];
+        scores[i] = pickedScores[i];
+
+        if (debugMode) {
+            NODE_LOG_DEBUG("ID(" << classIds[i] << ") score(" << scores[i] << ") BBOX(" << box[0] << ", " << box[1] << ", " << box[2] - box[0] << ", " << box[3] - box[1] << ")");
         }
+    }
+}
 
-        if (keep)
-            picked.push_back(i);
+// Decodes proposals of single image, suppresses overlapping ones and maps selected boxes to original image.
+// letterboxInfo is nullptr when boxes stay in model input coordinates.
+static int detectObjects(const float* output_buffer, const float* letterboxInfo, const YoloxPostprocessingParameters& parameters, ImageDetections& result) {
+    static thread_local DetectionProposals detections;
+    decodeProposals(output_buffer, parameters, detections);
+
+    // Letterboxed image is resized by ratio = min(input_w / original_w, input_h / original_h) and padded at right and bottom,
+    // so boxes are mapped back by dividing by ratio and clipped to original image.
+    float scale = 1.0f;
+    float clipWidth = parameters.sourceImageWidth;
+    float clipHeight = parameters.sourceImageHeight;
+    if (letterboxInfo != nullptr) {
+        NODE_ASSERT(letterboxInfo[0] > 0 && letterboxInfo[1] > 0 && letterboxInfo[2] > 0, "letterbox info values must be larger than 0");
+        scale = letterboxInfo[0];
+        clipHeight = letterboxInfo[1];
+        clipWidth = letterboxInfo[2];
     }
+    selectDetections(detections, scale, clipWidth, clipHeight, parameters, result);
+    return 0;
 }
 
-int initialize(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+// Decodes proposals of each tile in parallel and moves them by tile position. Proposals of all tiles are suppressed together,
+// so object seen by overlapping tiles is reported once. Boxes are clipped to original image of rows x cols.
+static int detectTiledObjects(const float* predictions, size_t tileSize, const std::vector<Tile>& tiles, int rows, int cols, const YoloxPostprocessingParameters& parameters, ImageDetections& result) {
+    static thread_local std::vector<DetectionProposals> tileDetections;
+    static thread_local DetectionProposals detections;
+    if (tileDetections.size() < tiles.size()) {
+        tileDetections.resize(tiles.size());
+    }
+    // Workers write through reference, thread_local name would resolve to their own instances.
+    std::vector<DetectionProposals>& tileProposals = tileDetections;
+    ovms::custom_nodes_common::parallel_for(tiles.size(), parameters.batchThreads, [&](size_t t) {
+        DetectionProposals& proposals = tileProposals[t];
+        decodeProposals(predictions + t * tileSize, parameters, proposals);
+        for (size_t i = 0; i < proposals.size(); i++) {
+            proposals.x[i] += tiles[t].x;
+            proposals.y[i] += tiles[t].y;
+        }
+    });
+    detections.clear();
+    for (size_t t = 0; t < tiles.size(); t++) {
+        detections.append(tileProposals[t]);
+    }
+    selectDetections(detections, 1.0f, cols, rows, parameters, result);
     return 0;
 }
 
+int initialize(void** customNodeLibraryInternalManager, const struct CustomNodeParam* params, int paramsCount) {
+    if (*customNodeLibraryInternalManager == nullptr) {
+        return initializeInternalManager(customNodeLibraryInternalManager, params, paramsCount);
+    }
+    return reinitializeInternalManagerIfNecessary(customNodeLibraryInternalManager, params, paramsCount);
+}
+
 int deinitialize(void* customNodeLibraryInternalManager) {
+    // deallocate InternalManager and its contents
+    if (customNodeLibraryInternalManager != nullptr) {
+        CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+        delete internalManager;
+    }
     return 0;
 }
 
 int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct CustomNodeTensor** outputs, int* outputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
-    // Parameters reading
-    int _sourceImageHeight = get_int_parameter("input_h", params, paramsCount, -1);
-    int _sourceImageWidth = get_int_parameter("input_w", params, paramsCount, -1);
-    NODE_ASSERT(_sourceImageHeight > 0 || _sourceImageHeight == -1, "Source image height - when specified, must be larger than 0");
-    NODE_ASSERT(_sourceImageWidth > 0 || _sourceImageHeight == -1, "Source image width - when specified, must be larger than 0");
-
-    int _numClass = get_int_parameter("num_class", params, paramsCount, -1);
-    NODE_ASSERT(_numClass > 0, "Number of class - must be larger than 0");
-
-    float _nmsThresh = get_float_parameter("nms_thresh", params, paramsCount, -1);
-    NODE_ASSERT(_nmsThresh > 0 || _nmsThresh <= 1, "NMS Threshold is bitween 0 and 1");
-
-    float _bboxConfThresh = get_float_parameter("bbox_conf_thresh", params, paramsCount, -1);
-    NODE_ASSERT(_bboxConfThresh > 0 || _bboxConfThresh <=1, "BBOX Confidence Threshold is bitween 0 and 1");
-
-    // // Debug flag for additional logging.
-    bool debugMode = get_string_parameter("debug", params, paramsCount) == "true";
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+    NODE_ASSERT(internalManager != nullptr, "internalManager is not initialized");
+    std::shared_lock<std::shared_timed_mutex> lock(internalManager->getInternalManagerLock());
+    ovms::custom_nodes_common::LogSettings::Scope logScope(internalManager->getLogSettings());
+
+    // Parameters are parsed and validated in initialize()
+    const YoloxPostprocessingParameters* parameters = internalManager->getParameters<YoloxPostprocessingParameters>();
+    NODE_ASSERT(parameters != nullptr, "node parameters are not initialized");
+    const int _sourceImageHeight = parameters->sourceImageHeight;
+    const int _sourceImageWidth = parameters->sourceImageWidth;
+    const int _numClass = parameters->numClass;
+    const float _nmsThresh = parameters->nmsThresh;
+    const float _bboxConfThresh = parameters->bboxConfThresh;
+    const bool debugMode = parameters->debugMode;
 
     // // ------------ validation start -------------
-    NODE_ASSERT(inputsCount == 1, "there must be exactly one input");
-    const CustomNodeTensor* imageTensor = inputs;
+    // letterbox_info is used only with rescale_boxes, without it boxes are returned in model input coordinates
+    // tile_info is required in tiling mode instead of letterbox_info
+    const CustomNodeTensor* imageTensor = nullptr;
+    const CustomNodeTensor* letterboxInfoTensor = nullptr;
+    const CustomNodeTensor* tileInfoTensor = nullptr;
+    for (int i = 0; i < inputsCount; i++) {
+        if (std::strcmp(inputs[i].name, TENSOR_NAME) == 0) {
+            imageTensor = &(inputs[i]);
+        } else if (parameters->rescaleBoxes && std::strcmp(inputs[i].name, LETTERBOX_INFO_TENSOR_NAME) == 0) {
+            letterboxInfoTensor = &(inputs[i]);
+        } else if (parameters->tiling && std::strcmp(inputs[i].name, TILE_INFO_TENSOR_NAME) == 0) {
+            tileInfoTensor = &(inputs[i]);
+        } else {
+            NODE_LOG_ERROR("Unrecognized input: " << inputs[i].name);
+            return 1;
+        }
+    }
+    NODE_ASSERT(imageTensor != nullptr, "Missing input image");
+    NODE_ASSERT(!parameters->tiling || tileInfoTensor != nullptr, "Missing input tile_info required by tiling");
+    NODE_ASSERT(!parameters->rescaleBoxes || letterboxInfoTensor != nullptr, "Missing input letterbox_info required by rescale_boxes");
     
     if(debugMode){
-        std::cout << "Validation Start, Input Data Checking" << std::endl;
-        std::cout << "inputsCount : " << inputsCount << std::endl;
-        std::cout << "Tensor name : " << imageTensor->name << ";" << TENSOR_NAME << std::endl;
-        std::cout << "dims count : " << imageTensor->dimsCount << std::endl;
+        NODE_LOG_DEBUG("Validation Start, Input Data Checking");
+        NODE_LOG_DEBUG("inputsCount : " << inputsCount);
+        NODE_LOG_DEBUG("Tensor name : " << imageTensor->name << ";" << TENSOR_NAME);
+        NODE_LOG_DEBUG("dims count : " << imageTensor->dimsCount);
     }
     
-    NODE_ASSERT(std::strcmp(imageTensor->name, TENSOR_NAME) == 0, "node input name is wrong");
     NODE_ASSERT(imageTensor->dimsCount == 3, "image tensor shape must have 4 dimensions")
-    NODE_ASSERT(imageTensor->dims[0] == 1, "image tensor must have batch size equal to 1")
+    NODE_ASSERT(imageTensor->precision == FP32, "image tensor precision must be FP32");
+    const uint64_t batchSize = imageTensor->dims[0];
+    NODE_ASSERT(batchSize > 0, "image tensor batch size must be positive");
 
     uint64_t inputNumBoxes = 0;
     uint64_t inputNumAttirib = 0;
@@ -171,173 +643,99 @@ int execute(const struct CustomNodeTensor* inputs, int inputsCount, struct Custo
     
     NODE_ASSERT(inputNumBoxes > 0 && inputNumAttirib > 0, "preds output shape must be positive");
     NODE_ASSERT(inputNumAttirib == (uint64_t)_numClass + 5 , "The number of Attribute must be the sum of the number of class, 1(obj score) and 4(bbox size). ");
-    //입력 사이즈에 대한 boxes개수를 계산할 수 있다면 체크하기.
+    NODE_ASSERT(inputNumBoxes == parameters->gridStrides.size(), "number of boxes must match anchors of configured input size and strides");
+    NODE_ASSERT(imageTensor->dataBytes == batchSize * inputNumBoxes * inputNumAttirib * sizeof(float), "number of input bytes does not match input shape");
 
     
 
     if (debugMode) {
-        std::cout << "source image height : " << _sourceImageHeight    << std::endl;
-        std::cout << "source image height : " << _sourceImageWidth     << std::endl;
-        std::cout << "number of class : "     << _numClass             << std::endl;
-        std::cout << "nms threshold "       << _nmsThresh          << std::endl;
-        std::cout << "bbox conf threshold " << _bboxConfThresh       << std::endl;
-        std::cout << "input shape[0] "      << imageTensor->dims[0] << std::endl;
-        std::cout << "input shape[1] "      << inputNumBoxes << std::endl;
-        std::cout << "input shape[2] "      << inputNumAttirib << std::endl;
+        NODE_LOG_DEBUG("source image height : " << _sourceImageHeight);
+        NODE_LOG_DEBUG("source image width : " << _sourceImageWidth);
+        NODE_LOG_DEBUG("number of class : " << _numClass);
+        NODE_LOG_DEBUG("nms threshold " << _nmsThresh);
+        NODE_LOG_DEBUG("bbox conf threshold " << _bboxConfThresh);
+        NODE_LOG_DEBUG("input shape[0] " << imageTensor->dims[0]);
+        NODE_LOG_DEBUG("input shape[1] " << inputNumBoxes);
+        NODE_LOG_DEBUG("input shape[2] " << inputNumAttirib);
     }
     // // ------------- validation end ---------------
 
-    const float* output_buffer = (float*)imageTensor->data;
-    std::vector<Object> objects;
-
-    // net_pred -> output_buffer
-    // decode_output (pred, objects, scale, img_w, img_h)
-    std::vector<Object> proposals;
-    std::vector<int> strides = {8, 16, 32};
-    std::vector<GridAndStride> grid_strides;
-
-    // generate_grids_and_stride(INPUT_W, INPUT_H, strides, grid_strides);
-    for (auto stride : strides)
-    {
-        int num_grid_w = _sourceImageWidth / stride;
-        int num_grid_h = _sourceImageHeight / stride;
-        for (int g1 = 0; g1 < num_grid_h; g1++)
-        {
-            for (int g0 = 0; g0 < num_grid_w; g0++)
-            {
-                grid_strides.push_back((GridAndStride){g0, g1, stride});
-                // if(debugMode){
-                //     std::cout << "Grid And Stride : " << "g0 : " << g0 <<  ", g1 : " << g1 << ", stride : " << stride << std::endl;
-                // }
-            }
+    // Tiles of batch are merged into detections of their image, which is the only image of outputs.
+    if (parameters->tiling) {
+        NODE_ASSERT(tileInfoTensor->precision == I32, "tile info input is not I32");
+        NODE_ASSERT(tileInfoTensor->dataBytes == batchSize * TILE_INFO_SIZE * sizeof(int32_t), "tile info input must have 6 values for each tile");
+        std::vector<Tile> tiles;
+        int rows = 0;
+        int cols = 0;
+        NODE_ASSERT(ovms::custom_nodes_common::read_tile_info(reinterpret_cast<const int32_t*>(tileInfoTensor->data), batchSize, tiles, rows, cols), "tile info must describe tiles covering image");
+        NODE_ASSERT(tiles[0].height == _sourceImageHeight && tiles[0].width == _sourceImageWidth, "tile size must be equal to input_h and input_w");
+        static thread_local std::vector<ImageDetections> tiledResults(1);
+        NODE_ASSERT(detectTiledObjects((const float*)imageTensor->data, inputNumBoxes * inputNumAttirib, tiles, rows, cols, *parameters, tiledResults[0]) == 0, "detection failed");
+        if (parameters->outputFormat == OutputFormat::COMPACT) {
+            NODE_ASSERT(writeCompactOutputs(internalManager, *parameters, tiledResults, 1, outputs, outputsCount) == 0, "compact outputs creation failed");
+        } else {
+            NODE_ASSERT(writeLegacyOutputs(internalManager, tiledResults, 1, outputs, outputsCount) == 0, "outputs creation failed");
         }
+        if (debugMode) {
+            internalManager->logStatistics();
+        }
+        return 0;
     }
 
-    // generate_yolox_proposals(grid_stirdes, pred, BBOX_CONF_THRESH, proposals)
-    const int num_anchors = grid_strides.size();
-    // std::cout << "NUM_ANCHORS : " << num_anchors << std::endl;
-
-    for (int anchor_idx = 0; anchor_idx < num_anchors; anchor_idx++)
-    {
-        const int grid0 = grid_strides[anchor_idx].grid0;
-        const int grid1 = grid_strides[anchor_idx].grid1;
-        const int stride = grid_strides[anchor_idx].stride;
-        // std::cout << "AnchorIdx(" << anchor_idx << ")" << grid0 << ", " << grid1 << ", " << stride;
-        // std::endl;
-
-        const int basic_pos = anchor_idx * (_numClass + 5);
-
-        // yolox/models/yolo_head.py decode logic
-        //  outputs[..., :2] = (outputs[..., :2] + grids) * strides
-        //  outputs[..., 2:4] = torch.exp(outputs[..., 2:4]) * strides
-        float x_center = (output_buffer[basic_pos + 0] + grid0) * stride;
-        float y_center = (output_buffer[basic_pos + 1] + grid1) * stride;
-        float w = exp(output_buffer[basic_pos + 2]) * stride;
-        float h = exp(output_buffer[basic_pos + 3]) * stride;
-        float x0 = x_center - w * 0.5f;
-        float y0 = y_center - h * 0.5f;
-
-        float box_objectness = output_buffer[basic_pos + 4];
-        for (int class_idx = 0; class_idx < _numClass; class_idx++)
-        {
-            float box_cls_score = output_buffer[basic_pos + 5 + class_idx];
-            float box_prob = box_objectness * box_cls_score;
-            if (box_prob > _bboxConfThresh)
-            {
-                
-                Object obj;
-                obj.box.x = x0;
-                obj.box.y = y0;
-                obj.box.width = w;
-                obj.box.height = h;
-                obj.class_id = class_idx;
-                obj.score = box_prob;
-
-                proposals.push_back(obj);
-
-                // std::cout << "Object : " << obj.class_id << " , " << obj.score << std::endl; 
-            }
-
-        } // class loop
-
-    } // point anchor loop
-
-    std::cout << "NUM OBJECTS : " << proposals.size() << std::endl;
-
-    //qsort_descent_inplace(proposals)
-    qsort_descent_inplace(proposals);
-
-    std::vector<int> picked;
-    nms_sorted_bboxes(proposals, picked, _nmsThresh);
-    int count = picked.size();
-    objects.resize(count);
-
-    std::cout << "NMS RESULT OBJECTS : " << count << std::endl;
-
-    float scale = 1.0; // scale -> min( src_width / ori_width, src_height / ori_height )
-
-    int data_depth = 6;
-    uint64_t byteSize = sizeof(float) * count * data_depth; // 6 = id, score, x, y, w, h
-    float* buffer = (float*)malloc(byteSize);
-    NODE_ASSERT(buffer != nullptr, "malloc has failed.");
-
-    for (int i = 0; i < count; i++)
-    {
-        objects[i] = proposals[picked[i]];
-
-        // adjust offset to original unpadded
-        float x0 = (objects[i].box.x) / scale;
-        float y0 = (objects[i].box.y) / scale;
-        float x1 = (objects[i].box.x + objects[i].box.width) / scale;
-        float y1 = (objects[i].box.y + objects[i].box.height) / scale;
-
-        // clip
-        x0 = std::max(std::min(x0, (float)(_sourceImageWidth - 1)), 0.f); // _source size -> original size
-        y0 = std::max(std::min(y0, (float)(_sourceImageHeight - 1)), 0.f); // _source size -> original size
-        x1 = std::max(std::min(x1, (float)(_sourceImageWidth - 1)), 0.f); // _source size -> original size
-        y1 = std::max(std::min(y1, (float)(_sourceImageHeight - 1)), 0.f); // _source size -> original size
-
-        objects[i].box.x = x0;
-        objects[i].box.y = y0;
-        objects[i].box.width = x1 - x0;
-        objects[i].box.height = y1 - y0;
-
-        std::cout << "ID(" << objects[i].class_id << ") score(" << objects[i].score << ") BBOX(" << objects[i].box.x<< ", "<< objects[i].box.y<< ", "<< objects[i].box.width << ", "<< objects[i].box.height<< ")" << std::endl;
-
-        int pos = i * data_depth;
-        buffer[pos + 0] = objects[i].class_id;
-        buffer[pos + 1] = objects[i].score * 100;
-        buffer[pos + 2] = objects[i].box.x;
-        buffer[pos + 3] = objects[i].box.y;
-        buffer[pos + 4] = objects[i].box.width;
-        buffer[pos + 5] = objects[i].box.height;
+    // Letterbox info holds one row per image or single row shared by all images of batch.
+    const float* letterboxInfo = nullptr;
+    size_t letterboxInfoStride = 0;
+    if (letterboxInfoTensor != nullptr) {
+        NODE_ASSERT(letterboxInfoTensor->precision == FP32, "letterbox info input is not FP32");
+        NODE_ASSERT(letterboxInfoTensor->dataBytes == LETTERBOX_INFO_SIZE * sizeof(float) || letterboxInfoTensor->dataBytes == batchSize * LETTERBOX_INFO_SIZE * sizeof(float),
+            "letterbox info input must have 3 values for each image or 3 values shared by all images");
+        letterboxInfo = reinterpret_cast<const float*>(letterboxInfoTensor->data);
+        letterboxInfoStride = letterboxInfoTensor->dataBytes == LETTERBOX_INFO_SIZE * sizeof(float) ? 0 : LETTERBOX_INFO_SIZE;
     }
 
-    *outputsCount = 1;
-    *outputs = (struct CustomNodeTensor*)malloc(*outputsCount * sizeof(CustomNodeTensor));
-
-    if ((*outputs) == nullptr) {
-        std::cout << "malloc has failed" << std::endl;
-        free(buffer);
-        return 1;
+    // Images of batch are decoded independently, results are kept until outputs are written.
+    // Workers write through reference, thread_local name would resolve to their own instances.
+    static thread_local std::vector<ImageDetections> batchResults;
+    std::vector<ImageDetections>& results = batchResults;
+    if (results.size() < batchSize) {
+        results.resize(batchSize);
     }
+    const float* predictions = (const float*)imageTensor->data;
+    const size_t imageSize = inputNumBoxes * inputNumAttirib;
+    std::atomic<int> failures{0};
+    ovms::custom_nodes_common::parallel_for(batchSize, parameters->batchThreads, [&](size_t b) {
+        const float* imageLetterboxInfo = letterboxInfo == nullptr ? nullptr : letterboxInfo + b * letterboxInfoStride;
+        if (detectObjects(predictions + b * imageSize, imageLetterboxInfo, *parameters, results[b]) != 0) {
+            failures++;
+        }
+    });
+    NODE_ASSERT(failures == 0, "detection failed");
 
-    CustomNodeTensor& output = (*outputs)[0];
-    output.name = TENSOR_NAME;
-    output.data = reinterpret_cast<uint8_t*>(buffer);
-    output.dataBytes = byteSize;
-    output.dimsCount = 3;
-    output.dims = (uint64_t*)malloc(output.dimsCount * sizeof(uint64_t));
-    NODE_ASSERT(output.dims != nullptr, "malloc has failed");
-    output.dims[0] = 1;
-    output.dims[1] = count;
-    output.dims[2] = data_depth;
-    output.precision = FP32;
+    if (parameters->outputFormat == OutputFormat::COMPACT) {
+        NODE_ASSERT(writeCompactOutputs(internalManager, *parameters, results, batchSize, outputs, outputsCount) == 0, "compact outputs creation failed");
+    } else {
+        NODE_ASSERT(writeLegacyOutputs(internalManager, results, batchSize, outputs, outputsCount) == 0, "outputs creation failed");
+    }
+    if (debugMode) {
+        internalManager->logStatistics();
+    }
     return 0;
 }
 
+int executeAsync(const struct CustomNodeTensor* inputs, int inputsCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager,
+    CustomNodeCompletionCallback callback, void* userContext) {
+    return execute_async(execute, inputs, inputsCount, params, paramsCount, customNodeLibraryInternalManager, callback, userContext);
+}
+
+int getCapabilities(struct CustomNodeCapabilities* capabilities, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
+    return set_capabilities(capabilities, CUSTOM_NODE_CAPABILITY_EXECUTE_ASYNC);
+}
+
 int getInputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
-    *infoCount = 1;
+    YoloxPostprocessingParameters parameters;
+    NODE_ASSERT(readParameters(params, paramsCount, parameters) == 0, "node parameters are invalid");
+
+    *infoCount = parameters.tiling || parameters.rescaleBoxes ? 2 : 1;
     *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
     NODE_ASSERT((*info) != nullptr, "malloc has failed");
     
@@ -345,28 +743,57 @@ int getInputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const stru
     (*info)[0].dimsCount = 3;
     (*info)[0].dims = (uint64_t*)malloc((*info)->dimsCount * sizeof(uint64_t));
     NODE_ASSERT(((*info)[0].dims) != nullptr, "malloc has failed");
-    (*info)[0].dims[0] = 1;
-    (*info)[0].dims[1] = 3549; // set as input image shape, stride = {8, 16, 32}, sum(width / stride * height / stride)
-    (*info)[0].dims[2] = 85; // set as the number of class, 1(obj score) + 4(bbox coord) + num_class
+    // number of tiles depends on image size
+    (*info)[0].dims[0] = parameters.maxBatchSize == 1 && !parameters.tiling ? 1 : 0;
+    (*info)[0].dims[1] = parameters.gridStrides.size();  // sum(width / stride * height / stride) over strides
+    (*info)[0].dims[2] = parameters.numClass + 5;  // 4(bbox coord) + 1(obj score) + num_class
     (*info)[0].precision = FP32;
+
+    if (*infoCount == 1) {
+        return 0;
+    }
+    (*info)[1].dimsCount = 2;
+    (*info)[1].dims = (uint64_t*)malloc((*info)[1].dimsCount * sizeof(uint64_t));
+    NODE_ASSERT(((*info)[1].dims) != nullptr, "malloc has failed");
+    if (parameters.tiling) {
+        // one row per tile
+        (*info)[1].name = TILE_INFO_TENSOR_NAME;
+        (*info)[1].dims[0] = 0;
+        (*info)[1].dims[1] = TILE_INFO_SIZE;
+        (*info)[1].precision = I32;
+        return 0;
+    }
+    (*info)[1].name = LETTERBOX_INFO_TENSOR_NAME;
+    // one row per image or single row shared by batch
+    (*info)[1].dims[0] = parameters.maxBatchSize == 1 ? 1 : 0;
+    (*info)[1].dims[1] = LETTERBOX_INFO_SIZE;
+    (*info)[1].precision = FP32;
     return 0;
 }
 
 int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const struct CustomNodeParam* params, int paramsCount, void* customNodeLibraryInternalManager) {
-    // // Parameters reading
-    int _sourceImageHeight = get_int_parameter("input_h", params, paramsCount, -1);
-    int _sourceImageWidth = get_int_parameter("input_w", params, paramsCount, -1);
-    NODE_ASSERT(_sourceImageHeight > 0 || _sourceImageHeight == -1, "Source image height - when specified, must be larger than 0");
-    NODE_ASSERT(_sourceImageWidth > 0 || _sourceImageHeight == -1, "Source image width - when specified, must be larger than 0");
-
-    int _numClass = get_int_parameter("num_class", params, paramsCount, -1);
-    NODE_ASSERT(_numClass > 0, "Number of classes - must be larger than 0");
-
-    float _nmsThresh = get_float_parameter("nms_thresh", params, paramsCount, -1);
-    NODE_ASSERT(_nmsThresh > 0 || _nmsThresh <= 1, "NMS Threshold is bitween 0 and 1");
-
-    float _bboxConfThresh = get_float_parameter("bbox_conf_thresh", params, paramsCount, -1);
-    NODE_ASSERT(_bboxConfThresh > 0 || _bboxConfThresh <=1, "BBOX Confidence Threshold is bitween 0 and 1");
+    YoloxPostprocessingParameters parameters;
+    NODE_ASSERT(readParameters(params, paramsCount, parameters) == 0, "node parameters are invalid");
+
+    if (parameters.outputFormat == OutputFormat::COMPACT) {
+        const uint64_t maxDetections = parameters.maxDetections;
+        const uint64_t batchSize = parameters.maxBatchSize == 1 || parameters.tiling ? 1 : 0;
+        *infoCount = COMPACT_OUTPUTS_COUNT;
+        *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
+        NODE_ASSERT((*info) != nullptr, "malloc has failed");
+        const char* names[COMPACT_OUTPUTS_COUNT] = {NUM_DETECTIONS_TENSOR_NAME, DETECTION_BOXES_TENSOR_NAME, DETECTION_SCORES_TENSOR_NAME, DETECTION_CLASSES_TENSOR_NAME};
+        const std::vector<uint64_t> shapes[COMPACT_OUTPUTS_COUNT] = {{batchSize, 1}, {batchSize, maxDetections, BOX_DEPTH}, {batchSize, maxDetections}, {batchSize, maxDetections}};
+        const CustomNodeTensorPrecision precisions[COMPACT_OUTPUTS_COUNT] = {I32, parameters.boxPrecision, FP32, I32};
+        for (int i = 0; i < COMPACT_OUTPUTS_COUNT; i++) {
+            (*info)[i].name = names[i];
+            (*info)[i].dimsCount = shapes[i].size();
+            (*info)[i].dims = (uint64_t*)malloc((*info)[i].dimsCount * sizeof(uint64_t));
+            NODE_ASSERT(((*info)[i].dims) != nullptr, "malloc has failed");
+            std::copy(shapes[i].begin(), shapes[i].end(), (*info)[i].dims);
+            (*info)[i].precision = precisions[i];
+        }
+        return 0;
+    }
 
     *infoCount = 1;
     *info = (struct CustomNodeTensorInfo*)malloc(*infoCount * sizeof(struct CustomNodeTensorInfo));
@@ -376,9 +803,9 @@ int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const str
     (*info)[0].dimsCount = 3;
     (*info)[0].dims = (uint64_t*)malloc((*info)->dimsCount * sizeof(uint64_t));
     NODE_ASSERT(((*info)[0].dims) != nullptr, "malloc has failed");
-    (*info)[0].dims[0] = 1;
+    (*info)[0].dims[0] = parameters.maxBatchSize == 1 || parameters.tiling ? 1 : 0;
     (*info)[0].dims[1] = -1;
-    (*info)[0].dims[2] = 6;
+    (*info)[0].dims[2] = DETECTION_DEPTH;
 
     (*info)[0].precision = FP32;
 
@@ -386,9 +813,9 @@ int getOutputsInfo(struct CustomNodeTensorInfo** info, int* infoCount, const str
 }
 
 int release(void* ptr, void* customNodeLibraryInternalManager) {
-    if (ptr != nullptr){
+    CustomNodeLibraryInternalManager* internalManager = static_cast<CustomNodeLibraryInternalManager*>(customNodeLibraryInternalManager);
+    if (internalManager == nullptr || !internalManager->releaseBuffer(ptr)) {
         free(ptr);
     }
-    ptr = nullptr;
     return 0;
 }
@@ -15,9 +15,14 @@
 //*****************************************************************************
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <future>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -138,4 +143,205 @@ protected:
     std::vector<T> inferRequests;
     std::queue<std::promise<int>> promises;
 };
+/**
+ * @brief Lock-free alternative to Queue with the same interface
+ *
+ * Idle stream ids are kept in a bounded MPMC ring of sequence-numbered cells,
+ * so acquiring and returning an idle stream takes no lock and allocates nothing.
+ * Only when the ring is empty getIdleStream() falls back to a waiter list guarded by a mutex.
+ */
+template <typename T>
+class LockFreeQueue {
+public:
+    /**
+    * @brief Allocating idle stream for execution
+    */
+    std::future<int> getIdleStream() {
+        std::promise<int> idleStreamPromise;
+        std::future<int> idleStreamFuture = idleStreamPromise.get_future();
+        std::optional<int> value = tryToGetIdleStream();
+        if (!value.has_value()) {
+            std::unique_lock<std::mutex> lk(waitersMutex);
+            // Registration has to be visible before retrying, otherwise returnStream()
+            // could push an id to the ring after our retry and skip the waiter list.
+            waitersCount.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            value = tryToGetIdleStream();
+            if (!value.has_value()) {  // we need to wait for any idle stream to be returned
+                waiters.push_back(std::move(idleStreamPromise));
+                return idleStreamFuture;
+            }
+            waitersCount.fetch_sub(1);
+        }
+        idleStreamPromise.set_value(value.value());
+        return idleStreamFuture;
+    }
+
+    /**
+    * @brief Allocating idle stream, waiting at most timeout for one to be returned
+    */
+    std::optional<int> tryToGetIdleStreamFor(std::chrono::microseconds timeout) {
+        std::optional<int> value = tryToGetIdleStream();
+        if (value.has_value()) {
+            return value;
+        }
+        std::future<int> idleStreamFuture;
+        typename std::list<std::promise<int>>::iterator waiter;
+        {
+            std::unique_lock<std::mutex> lk(waitersMutex);
+            waitersCount.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            value = tryToGetIdleStream();
+            if (value.has_value()) {
+                waitersCount.fetch_sub(1);
+                return value;
+            }
+            waiter = waiters.emplace(waiters.end());
+            idleStreamFuture = waiter->get_future();
+        }
+        if (idleStreamFuture.wait_for(timeout) == std::future_status::ready) {
+            return idleStreamFuture.get();
+        }
+        std::unique_lock<std::mutex> lk(waitersMutex);
+        // promises are fulfilled under waitersMutex, so either stream was handed over in the meantime
+        // or waiter is still on the list and can be safely removed
+        if (idleStreamFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            return idleStreamFuture.get();
+        }
+        waiters.erase(waiter);
+        waitersCount.fetch_sub(1);
+        return std::nullopt;
+    }
+
+    std::optional<int> tryToGetIdleStream() {
+        std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {  // ring is empty
+                return std::nullopt;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        int value = cell->value;
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return value;
+    }
+
+    /**
+    * @brief Release stream after execution
+    */
+    void returnStream(int streamID) {
+        push(streamID);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waitersCount.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        std::unique_lock<std::mutex> lk(waitersMutex);
+        if (waiters.empty()) {
+            return;
+        }
+        // Id we have just pushed might have been already taken by other thread,
+        // in that case waiter will be served by the next returned stream.
+        std::optional<int> value = tryToGetIdleStream();
+        if (!value.has_value()) {
+            return;
+        }
+        waiters.front().set_value(value.value());
+        waiters.pop_front();
+        waitersCount.fetch_sub(1);
+    }
+
+    /**
+    * @brief Constructor with initialization
+    *
+    * Ring is sized for capacity stream ids, while only first streamsLength ids are idle initially.
+    * Remaining ids can be added later with returnStream().
+    */
+    LockFreeQueue(int streamsLength, int capacity = 0) :
+        mask(ringCapacity(std::max(streamsLength, capacity)) - 1),
+        cells(std::make_unique<Cell[]>(mask + 1)),
+        enqueuePos{0},
+        dequeuePos{0},
+        waitersCount{0} {
+        for (std::size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < streamsLength; ++i) {
+            push(i);
+        }
+    }
+
+    /**
+     * @brief Give InferRequest
+     */
+    T& getInferRequest(int streamID) {
+        return inferRequests[streamID];
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<std::size_t> sequence;
+        int value;
+    };
+
+    static std::size_t ringCapacity(int streamsLength) {
+        std::size_t capacity = 1;
+        while (capacity < static_cast<std::size_t>(streamsLength)) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    /**
+    * @brief Ring never overflows since it is sized to hold all stream ids
+    */
+    void push(int streamID) {
+        std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = streamID;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    const std::size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    /**
+    * @brief Producer and consumer positions are kept on separate cache lines
+    */
+    alignas(64) std::atomic<std::size_t> enqueuePos;
+    alignas(64) std::atomic<std::size_t> dequeuePos;
+
+    /**
+    * @brief Slow path used only when there is no idle stream available
+    */
+    alignas(64) std::atomic<std::size_t> waitersCount;
+    std::mutex waitersMutex;
+    std::list<std::promise<int>> waiters;
+
+protected:
+    /**
+     * @brief Resources assigned to stream ids
+     */
+    std::vector<T> inferRequests;
+};
 }  // namespace ovms
@@ -0,0 +1,117 @@
+//*****************************************************************************
+// Copyright 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//*****************************************************************************
+// Acquire/release throughput of idle stream queues: Queue and LockFreeQueue.
+// Each thread repeatedly takes idle stream with getIdleStream(), holds it for given number of spin iterations
+// and returns it with returnStream(). Ownership of every stream is checked, so lost or duplicated ids abort the run.
+//
+// Build and run from src:
+//   g++ -std=c++17 -O2 -pthread queue_benchmark.cpp -o queue_benchmark && ./queue_benchmark [streams] [milliseconds] [hold]
+//   streams      - number of idle streams in queue, 8 by default
+//   milliseconds - duration of each measurement, 500 by default
+//   hold         - spin iterations stream is held for, 0 by default
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "queue.hpp"
+
+namespace {
+struct Result {
+    double operationsPerSecond;
+    double microsecondsPerOperation;
+};
+
+template <typename QueueType>
+Result measure(int threadsCount, int streams, std::chrono::milliseconds duration, int hold) {
+    QueueType queue(streams);
+    std::unique_ptr<std::atomic<int>[]> owners(new std::atomic<int>[streams]);
+    for (int i = 0; i < streams; i++) {
+        owners[i].store(-1);
+    }
+    std::atomic<bool> started{false};
+    std::atomic<bool> stopping{false};
+    std::vector<uint64_t> operations(threadsCount, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadsCount; t++) {
+        threads.emplace_back([&, t]() {
+            while (!started.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            uint64_t count = 0;
+            volatile int sink = 0;
+            while (!stopping.load(std::memory_order_relaxed)) {
+                int streamId = queue.getIdleStream().get();
+                int expected = -1;
+                if (streamId < 0 || streamId >= streams || !owners[streamId].compare_exchange_strong(expected, t)) {
+                    std::fprintf(stderr, "stream %d handed out twice\n", streamId);
+                    std::abort();
+                }
+                for (int i = 0; i < hold; i++) {
+                    sink = sink + i;
+                }
+                owners[streamId].store(-1);
+                queue.returnStream(streamId);
+                count++;
+            }
+            operations[t] = count;
+        });
+    }
+    auto begin = std::chrono::steady_clock::now();
+    started.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stopping.store(true);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    uint64_t total = 0;
+    for (uint64_t count : operations) {
+        total += count;
+    }
+    // every stream must be idle again
+    for (int i = 0; i < streams; i++) {
+        if (!queue.tryToGetIdleStream().has_value()) {
+            std::fprintf(stderr, "stream lost\n");
+            std::abort();
+        }
+    }
+    return Result{total / seconds, total > 0 ? seconds * 1e6 * threadsCount / total : 0.0};
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    const int streams = argc > 1 ? std::stoi(argv[1]) : 8;
+    const auto duration = std::chrono::milliseconds(argc > 2 ? std::stoi(argv[2]) : 500);
+    const int hold = argc > 3 ? std::stoi(argv[3]) : 0;
+    if (streams <= 0 || duration.count() <= 0 || hold < 0) {
+        std::fprintf(stderr, "usage: %s [streams > 0] [milliseconds > 0] [hold >= 0]\n", argv[0]);
+        return 1;
+    }
+    std::printf("streams %d, %lld ms per measurement, hold %d, %u hardware threads\n", streams, (long long)duration.count(), hold, std::thread::hardware_concurrency());
+    std::printf("%8s %18s %14s %18s %14s %8s\n", "threads", "Queue ops/s", "us/op/thread", "LockFreeQueue ops/s", "us/op/thread", "speedup");
+    for (int threadsCount : {1, 2, 4, 8, 16, 32, 64}) {
+        Result locked = measure<ovms::Queue<int>>(threadsCount, streams, duration, hold);
+        Result lockFree = measure<ovms::LockFreeQueue<int>>(threadsCount, streams, duration, hold);
+        std::printf("%8d %18.0f %14.3f %18.0f %14.3f %7.2fx\n", threadsCount, locked.operationsPerSecond, locked.microsecondsPerOperation,
+            lockFree.operationsPerSecond, lockFree.microsecondsPerOperation, lockFree.operationsPerSecond / locked.operationsPerSecond);
+    }
+    return 0;
+}